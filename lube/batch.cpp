@@ -0,0 +1,183 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#include <memory>
+
+#include "lube/batch.h"
+
+using namespace libube;
+
+
+/** Serialises the output of the timers of different workers */
+static std::mutex sTimerMutex;
+
+
+/**
+ * A copy of iVar sharing no heap with it.  copy() is shallow, so the elements
+ * of arrays of vars and the keys and values of maps are copied in turn.
+ */
+static var deepcopy(var iVar)
+{
+    var r = iVar.dereference().copy();
+    if (!r.heap())
+        return r;
+    if (r.atype<var>())
+        for (var& v : r.span<var>())
+            v = deepcopy(v);
+    else if (r.atype<pair>())
+        for (pair& p : r.items())
+        {
+            p.key = deepcopy(p.key);
+            p.val = deepcopy(p.val);
+        }
+    return r;
+}
+
+
+/**
+ * Creates the module instances and starts the workers.  Everything that
+ * touches a var shared with the caller happens here, in the calling thread.
+ */
+batch::batch(var iFiles, var iAttr)
+{
+    mNext = 0;
+    mHead = 0;
+    mStop = false;
+    mTiming = iAttr && iAttr.at("timing");
+    int threads = (iAttr && iAttr.at("threads"))
+        ? iAttr.at("threads").cast<int>() : 0;
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    int prefetch = (iAttr && iAttr.at("prefetch"))
+        ? iAttr.at("prefetch").cast<int>() : 2 * threads;
+    if (prefetch < 1)
+        throw error("batch::batch(): prefetch must be positive");
+
+    for (int i=0; i<iFiles.size(); i++)
+        mFile.push_back(iFiles.at(i).str());
+    mSlot.resize(prefetch);
+    mModule = new filemodule(
+        (iAttr && iAttr.at("module")) ? iAttr.at("module") : var("snd")
+    );
+    var modAttr = iAttr ? iAttr.at("attr") : nil;
+    modAttr.dereference();
+    if (modAttr.heap() && modAttr.atype<pair>() && modAttr.at("intern"))
+    {
+        // Interned strings stay in the table of the thread that interned
+        // them, so would still be shared after hand over
+        var a;
+        for (pair& p : modAttr.items())
+            if (p.key != "intern")
+                a[p.key] = p.val;
+        modAttr = a;
+    }
+    for (int w=0; w<threads; w++)
+        mReader.push_back(
+            &mModule->create(modAttr ? deepcopy(modAttr) : nil)
+        );
+    for (int w=0; w<threads; w++)
+        mThread.emplace_back(&batch::work, this, w);
+}
+
+
+batch::~batch()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mSpace.notify_all();
+    for (size_t i=0; i<mThread.size(); i++)
+        mThread[i].join();
+    mSlot.clear();
+    delete mModule;
+}
+
+
+/**
+ * Worker thread.  Claims the next file whenever its slot is free, and reads
+ * it without holding the lock.
+ */
+void batch::work(int iWorker)
+{
+    int size = mFile.size();
+    int prefetch = mSlot.size();
+    for (;;)
+    {
+        int n;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mSpace.wait(lock, [&]{
+                return mStop || (mNext >= size) || (mNext < mHead + prefetch);
+            });
+            if (mStop || (mNext >= size))
+                return;
+            n = mNext++;
+        }
+
+        var data;
+        std::exception_ptr err;
+        std::unique_ptr<timer> t;
+        try
+        {
+            if (mTiming)
+                t.reset(new timer(mFile[n].c_str()));
+            data = mReader[iWorker]->read(mFile[n].c_str());
+        }
+        catch (...)
+        {
+            err = std::current_exception();
+        }
+        if (t)
+        {
+            std::lock_guard<std::mutex> lock(sTimerMutex);
+            t.reset();
+        }
+
+        // The worker's reference must be gone before the consumer can see
+        // the data
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            slot& s = mSlot[n % prefetch];
+            s.data = data;
+            data = nil;
+            s.error = err;
+            s.ready = true;
+        }
+        mReady.notify_all();
+    }
+}
+
+
+/**
+ * Hands over the next file in list order, waiting for it if necessary.
+ * Returns false when the list is exhausted.  Rethrows any error raised while
+ * reading the file.
+ */
+bool batch::next(var& oData)
+{
+    std::exception_ptr err;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mHead >= (int)mFile.size())
+            return false;
+        slot& s = mSlot[mHead % mSlot.size()];
+        mReady.wait(lock, [&]{ return s.ready; });
+        oData = s.data;
+        s.data = nil;
+        err = s.error;
+        s.error = nullptr;
+        s.ready = false;
+        mHead++;
+    }
+    mSpace.notify_all();
+    if (err)
+        std::rethrow_exception(err);
+    return true;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <lube/module.h>
+
+namespace libube
+{
+    /**
+     * Parallel batch file reader
+     *
+     * Reads a list of files on a pool of worker threads, each with its own
+     * instance of a file module, into a bounded queue that next() drains in
+     * list order.  The workers read ahead by at most the queue size, so the
+     * consumer only waits if decoding is slower than consumption.  Each
+     * result is allocated once by the module (at its final size for snd) and
+     * then handed over to the consumer, which owns it outright.
+     *
+     * The attribute var may contain:
+     *  - "module": the file module, default "snd"
+     *  - "attr": the attributes with which to create the module instances;
+     *    each worker gets its own deep copy, without any "intern", as the
+     *    strings interned by a worker would remain shared with its results
+     *  - "threads": the number of workers; zero or fewer is one per core
+     *  - "prefetch": the queue size, default twice the number of workers
+     *  - "timing": if set, the decoding of each file is timed with a timer
+     */
+    class batch
+    {
+    public:
+        batch(var iFiles, var iAttr=nil);
+        ~batch();
+        bool next(var& oData);
+    private:
+        struct slot
+        {
+            var data;
+            std::exception_ptr error;
+            bool ready = false;
+        };
+        filemodule* mModule;
+        std::vector<file*> mReader;
+        std::vector<std::string> mFile;
+        std::vector<slot> mSlot;
+        std::vector<std::thread> mThread;
+        std::mutex mMutex;
+        std::condition_variable mReady;  ///< A slot has been filled
+        std::condition_variable mSpace;  ///< A slot has been emptied
+        int mNext;      ///< Next file to read
+        int mHead;      ///< Next file to hand out
+        bool mStop;
+        bool mTiming;
+        void work(int iWorker);
+    };
+}
+
+#endif // BATCH_H
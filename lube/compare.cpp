@@ -0,0 +1,316 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#include <algorithm>
+#include <complex>
+#include <cstring>
+
+#include "lube/var.h"
+#include "lube/heap.h"
+
+using namespace libube;
+
+
+/*
+ * Comparison kernels
+ *
+ * Finding the type, heap and size of a var goes through the heap when the var
+ * is a reference, so each operand is resolved once.  Arrays of the same
+ * dense type are then compared as plain arrays: memcmp where the bytes
+ * decide, otherwise typed loops.  Arrays of vars (and the values of maps)
+ * are compared element by element, recursively.
+ */
+namespace
+{
+    struct operand
+    {
+        operand(const var& iVar);
+        const var& v;
+        IHeap* heap;
+        ind type;
+        ind atype;
+        int size;
+    };
+}
+
+operand::operand(const var& iVar) : v(iVar)
+{
+    heap = iVar.heap();
+    type = heap ? (ind)TYPE_ARRAY : iVar.type();
+    atype = heap ? heap->type() : type;
+    size = heap ? heap->size() : (iVar.defined() ? 1 : 0);
+}
+
+/** Orders complex numbers by magnitude, as operator<() always has */
+template<class T>
+static inline int cmp(const T& iA, const T& iB)
+{
+    return (iA < iB) ? -1 : (iB < iA) ? 1 : 0;
+}
+
+template<class T>
+static inline int cmp(const std::complex<T>& iA, const std::complex<T>& iB)
+{
+    if (int c = cmp(std::abs(iA), std::abs(iB)))
+        return c;
+    if (int c = cmp(iA.real(), iB.real()))
+        return c;
+    return cmp(iA.imag(), iB.imag());
+}
+
+template<class T>
+static int scalar(const var& iA, const var& iB)
+{
+    return cmp(iA.get<T>(), iB.get<T>());
+}
+
+/** The first difference decides; failing that, the shorter is less */
+template<class T>
+static int dense(const T* iA, int iSizeA, const T* iB, int iSizeB)
+{
+    int n = std::min(iSizeA, iSizeB);
+    int i = 0;
+    while ((i < n) && (iA[i] == iB[i]))
+        i++;
+    if (i < n)
+        return cmp(iA[i], iB[i]);
+    return cmp(iSizeA, iSizeB);
+}
+
+static int dense(const char* iA, int iSizeA, const char* iB, int iSizeB)
+{
+    if (int c = std::memcmp(iA, iB, std::min(iSizeA, iSizeB)))
+        return c;
+    return cmp(iSizeA, iSizeB);
+}
+
+template<class T>
+static bool dense(const T* iA, const T* iB, int iSize)
+{
+    bool eq = true;
+    for (int i=0; i<iSize; i++)
+        eq &= (iA[i] == iB[i]);
+    return eq;
+}
+
+/** The i'th element of an array as a var */
+static var element(const operand& iOp, int iIndex)
+{
+    switch (iOp.atype)
+    {
+    case TYPE_VAR:
+        return *iOp.heap->ptrvar(iIndex);
+    case TYPE_PAIR:
+        return iOp.heap->ptrpair(iIndex)->val;
+    default:
+        return iOp.heap->at(iIndex);
+    }
+}
+
+static int compare(const operand& iA, const operand& iB);
+
+static int array(const operand& iA, const operand& iB)
+{
+    IHeap* a = iA.heap;
+    IHeap* b = iB.heap;
+    if (!a || !b)
+        return cmp(iA.size, iB.size);
+    if (iA.atype == iB.atype)
+        switch (iA.atype)
+        {
+        case TYPE_CHAR:
+            return dense(a->ptrchar(), iA.size, b->ptrchar(), iB.size);
+        case TYPE_INT:
+            return dense(a->ptrint(), iA.size, b->ptrint(), iB.size);
+        case TYPE_LONG:
+            return dense(a->ptrlong(), iA.size, b->ptrlong(), iB.size);
+        case TYPE_FLOAT:
+            return dense(a->ptrfloat(), iA.size, b->ptrfloat(), iB.size);
+        case TYPE_DOUBLE:
+            return dense(a->ptrdouble(), iA.size, b->ptrdouble(), iB.size);
+        case TYPE_CFLOAT:
+            return dense(a->ptrcfloat(), iA.size, b->ptrcfloat(), iB.size);
+        case TYPE_CDOUBLE:
+            return dense(
+                a->ptrcdouble(), iA.size, b->ptrcdouble(), iB.size
+            );
+        default:
+            break;
+        }
+    int n = std::min(iA.size, iB.size);
+    for (int i=0; i<n; i++)
+    {
+        var ea = element(iA, i);
+        var eb = element(iB, i);
+        if (int c = compare(operand(ea), operand(eb)))
+            return c;
+    }
+    return cmp(iA.size, iB.size);
+}
+
+/**
+ * Three way comparison.  Vars order first by type, scalars then by value
+ * and arrays lexicographically.
+ */
+static int compare(const operand& iA, const operand& iB)
+{
+    if (iA.heap && (iA.heap == iB.heap))
+        return 0;
+    if (iA.type != iB.type)
+        return cmp(iA.type, iB.type);
+    switch (iA.type)
+    {
+    case TYPE_ARRAY: return array(iA, iB);
+    case TYPE_CHAR: return scalar<char>(iA.v, iB.v);
+    case TYPE_INT: return scalar<int>(iA.v, iB.v);
+    case TYPE_LONG: return scalar<long>(iA.v, iB.v);
+    case TYPE_FLOAT: return scalar<float>(iA.v, iB.v);
+    case TYPE_DOUBLE: return scalar<double>(iA.v, iB.v);
+    case TYPE_CFLOAT: return scalar<cfloat>(iA.v, iB.v);
+    case TYPE_CDOUBLE: return scalar<cdouble>(iA.v, iB.v);
+    default:
+        throw error("compare(): Unknown type");
+    }
+}
+
+/**
+ * Equality.  Sizes are compared before any elements, and arrays whose bytes
+ * decide equality are compared with memcmp.
+ */
+static bool equal(const operand& iA, const operand& iB)
+{
+    if (iA.heap && (iA.heap == iB.heap))
+        return true;
+    if ((iA.type != iB.type) || (iA.size != iB.size))
+        return false;
+    if (iA.type != TYPE_ARRAY)
+        switch (iA.type)
+        {
+        case TYPE_CHAR: return iA.v.get<char>() == iB.v.get<char>();
+        case TYPE_INT: return iA.v.get<int>() == iB.v.get<int>();
+        case TYPE_LONG: return iA.v.get<long>() == iB.v.get<long>();
+        case TYPE_FLOAT: return iA.v.get<float>() == iB.v.get<float>();
+        case TYPE_DOUBLE: return iA.v.get<double>() == iB.v.get<double>();
+        case TYPE_CFLOAT: return iA.v.get<cfloat>() == iB.v.get<cfloat>();
+        case TYPE_CDOUBLE:
+            return iA.v.get<cdouble>() == iB.v.get<cdouble>();
+        default:
+            throw error("equal(): Unknown type");
+        }
+
+    IHeap* a = iA.heap;
+    IHeap* b = iB.heap;
+    if (!a || !b)
+        return true;
+    int n = iA.size;
+    if (iA.atype == iB.atype)
+        switch (iA.atype)
+        {
+        case TYPE_CHAR:
+            return !std::memcmp(a->ptrchar(), b->ptrchar(), n);
+        case TYPE_INT:
+            return !std::memcmp(a->ptrint(), b->ptrint(), n*sizeof(int));
+        case TYPE_LONG:
+            return !std::memcmp(a->ptrlong(), b->ptrlong(), n*sizeof(long));
+        case TYPE_FLOAT:
+            return dense(a->ptrfloat(), b->ptrfloat(), n);
+        case TYPE_DOUBLE:
+            return dense(a->ptrdouble(), b->ptrdouble(), n);
+        case TYPE_CFLOAT:
+            return dense(a->ptrcfloat(), b->ptrcfloat(), n);
+        case TYPE_CDOUBLE:
+            return dense(a->ptrcdouble(), b->ptrcdouble(), n);
+        default:
+            break;
+        }
+    for (int i=0; i<n; i++)
+    {
+        var ea = element(iA, i);
+        var eb = element(iB, i);
+        if (!equal(operand(ea), operand(eb)))
+            return false;
+    }
+    return true;
+}
+
+
+bool var::operator !=(var iVar) const
+{
+    return !equal(operand(*this), operand(iVar));
+}
+
+
+/*
+ * Operator <
+ *
+ * This is the one that gets used by std::map in its search.
+ */
+bool var::operator <(var iVar) const
+{
+    return ::compare(operand(*this), operand(iVar)) < 0;
+}
+
+
+/**
+ * Three way comparison: negative, zero or positive as this var is less than,
+ * equal to or greater than iVar in the sense of operator<().
+ */
+int var::compare(var iVar) const
+{
+    return ::compare(operand(*this), operand(iVar));
+}
+
+
+/**
+ * Binary search
+ *
+ * Returns the index of the first element (the first key, for a map) not less
+ * than iData.  If oFound is given, it says whether that element is equal to
+ * iData.  Each step is one three way comparison, and an equal element ends
+ * the search, as keys of maps are unique.
+ */
+int var::binary(var iData, bool* oFound) const
+{
+    if (oFound)
+        *oFound = false;
+    if (size() == 0)
+        return 0;
+
+    IHeap* h = heap();
+    bool p =  // index on key rather than value
+        (h && this->atype<pair>());
+    operand data(iData);
+    int lo = 0;
+    int hi = size();
+    while (lo != hi)
+    {
+        int pos = (hi-lo)/2 + lo;
+        int c;
+        if (p)
+            c = ::compare(operand(h->ptrpair(pos)->key), data);
+        else
+        {
+            var x = at(pos);
+            c = ::compare(operand(x), data);
+        }
+        if (c < 0)
+            lo = pos+1;
+        else if (c > 0)
+            hi = pos;
+        else if (p)
+        {
+            if (oFound)
+                *oFound = true;
+            return pos;
+        }
+        else
+            hi = pos;
+    }
+    return hi;
+}
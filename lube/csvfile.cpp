@@ -0,0 +1,405 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+#include <lube/module.h>
+#include <lube/lines.h>
+
+namespace libube
+{
+    /**
+     * Numeric delimited text (CSV) file handler
+     *
+     * Reads a table of numbers into a dense [rows x cols] view, and writes a
+     * matrix (or a vector, as a column) back out.  Numbers are converted with
+     * std::from_chars and std::to_chars rather than via streams.  Lines that
+     * are empty or begin with '#' are skipped.
+     *
+     * The attribute var passed at creation may contain:
+     *  - "type": an exemplar of the element type; float (default) or double
+     *  - "delimiter": the field separator; by default fields are separated by
+     *    white space and/or a comma
+     *  - "header": the number of lines to skip; the last of them gives the
+     *    column names
+     *  - "columns": the columns to read, by index or by header name, each
+     *    at most once
+     *  - "threads": read in parallel chunks; zero or fewer is one per core
+     *  - "names": when writing, a header line of column names
+     */
+    class csvfile : public file
+    {
+    public:
+        csvfile(var iAttr) { mAttr = iAttr; };
+        virtual var read(var iFile);
+        virtual void write(var iFile, var iVar);
+    private:
+        var mAttr;
+        char mDelim;
+        var attr(var iKey) { return mAttr ? mAttr.at(iKey) : nil; };
+        template<class T> var read(const char* iBeg, const char* iEnd);
+        template<class T> void write(std::ostream& iOS, var iVar);
+        int fields(const char* iBeg, const char* iEnd, var* oNames=0);
+    };
+
+    void factory(Module** oModule, var iArg)
+    {
+        *oModule = new csvfile(iArg);
+    }
+}
+
+
+using namespace libube;
+
+
+static bool space(char iC)
+{
+    return (iC == ' ') || (iC == '\t') || (iC == '\r');
+}
+
+
+/**
+ * Splits off the field starting at iP, setting oEnd to the end of its
+ * content.  With no delimiter, fields end at white space or a comma.  Returns
+ * the start of the next field, or 0 at the end of the line.
+ */
+static const char* field(
+    const char* iP, const char* iEOL, char iDelim, const char*& oEnd
+)
+{
+    const char* q = iP;
+    if (iDelim)
+    {
+        while ((q < iEOL) && (*q != iDelim))
+            q++;
+        oEnd = q;
+        while ((oEnd > iP) && space(oEnd[-1]))
+            oEnd--;
+        if (q == iEOL)
+            return 0;
+        q++;
+    }
+    else
+    {
+        while ((q < iEOL) && !space(*q) && (*q != ','))
+            q++;
+        oEnd = q;
+        while ((q < iEOL) && space(*q))
+            q++;
+        if (q == iEOL)
+            return 0;
+        if (*q == ',')
+            q++;
+    }
+    while ((q < iEOL) && space(*q) && (*q != iDelim))
+        q++;
+    return q;
+}
+
+
+/**
+ * Counts the fields of a line, optionally returning them as names.
+ */
+int csvfile::fields(const char* iBeg, const char* iEnd, var* oNames)
+{
+    int n = 0;
+    const char* p = iBeg;
+    while ((p < iEnd) && space(*p) && (*p != mDelim))
+        p++;
+    while (p)
+    {
+        const char* e;
+        const char* q = field(p, iEnd, mDelim, e);
+        if (oNames)
+            oNames->push(var(e-p, p));
+        n++;
+        p = q;
+    }
+    return n;
+}
+
+
+namespace
+{
+    /**
+     * The state of one parsing thread: its part of the data and the rows it
+     * produced.
+     */
+    template<class T>
+    struct chunk
+    {
+        const char* beg;
+        const char* end;
+        std::vector<T> data;
+        int rows;
+        std::exception_ptr error;
+    };
+}
+
+
+/**
+ * Parses the lines of a chunk into a dense row major array.  iCol maps each
+ * field of a line to its output column, or -1 to skip it.  Empty fields are
+ * NaN.
+ */
+template<class T>
+static void parse(chunk<T>* ioChunk, const std::vector<int>* iCol, int iCols,
+                  char iDelim)
+{
+    try
+    {
+        const std::vector<int>& col = *iCol;
+        const char* p = ioChunk->beg;
+        const char* end = ioChunk->end;
+        ioChunk->rows = 0;
+        while (p < end)
+        {
+            const char* nl = (const char*)std::memchr(p, '\n', end - p);
+            const char* eol = nl ? nl : end;
+            while ((p < eol) && space(*p) && (*p != iDelim))
+                p++;
+            if ((p == eol) || (*p == '#'))
+            {
+                p = eol + 1;
+                continue;
+            }
+            size_t row = ioChunk->data.size();
+            ioChunk->data.resize(row + iCols);
+            T* r = ioChunk->data.data() + row;
+            int f = 0;
+            while (p)
+            {
+                if (f >= (int)col.size())
+                    throw error("csvfile::read(): too many fields");
+                const char* e;
+                const char* q = field(p, eol, iDelim, e);
+                if (col[f] >= 0)
+                {
+                    T& v = r[col[f]];
+                    if ((p < e) && (*p == '+'))
+                        p++;
+                    auto res = std::from_chars(p, e, v);
+                    if (p == e)
+                        v = std::numeric_limits<T>::quiet_NaN();
+                    else if (res.ec == std::errc::result_out_of_range)
+                        v = std::strtod(std::string(p, e).c_str(), 0);
+                    else if ((res.ec != std::errc()) || (res.ptr != e))
+                        throw error("csvfile::read(): not a number");
+                }
+                f++;
+                p = q;
+            }
+            if (f != (int)col.size())
+                throw error("csvfile::read(): too few fields");
+            ioChunk->rows++;
+            p = eol + 1;
+        }
+    }
+    catch (...)
+    {
+        ioChunk->error = std::current_exception();
+    }
+}
+
+
+/**
+ * Reads the data lines in [iBeg, iEnd).  The header and first data line
+ * define the columns; the rest are split at newlines into one chunk per
+ * thread and the chunks copied into the result once parsed.
+ */
+template<class T>
+var csvfile::read(const char* iBeg, const char* iEnd)
+{
+    // Header
+    var names;
+    int header = attr("header") ? attr("header").cast<int>() : 0;
+    const char* p = iBeg;
+    for (int h=0; h<header; h++)
+    {
+        const char* nl = (const char*)std::memchr(p, '\n', iEnd - p);
+        const char* eol = nl ? nl : iEnd;
+        if (h == header-1)
+            fields(p, eol, &names);
+        p = nl ? nl + 1 : iEnd;
+    }
+
+    // The first data line gives the number of fields
+    const char* q = p;
+    int nFields = 0;
+    while (q < iEnd)
+    {
+        const char* nl = (const char*)std::memchr(q, '\n', iEnd - q);
+        const char* eol = nl ? nl : iEnd;
+        const char* s = q;
+        while ((s < eol) && space(*s) && (*s != mDelim))
+            s++;
+        if ((s < eol) && (*s != '#'))
+        {
+            nFields = fields(s, eol);
+            break;
+        }
+        q = eol + 1;
+    }
+    if (nFields == 0)
+        return nil;
+
+    // Map fields to output columns
+    std::vector<int> col(nFields, -1);
+    int nCols = 0;
+    var sel = attr("columns");
+    if (sel)
+        for (int i=0; i<sel.size(); i++)
+        {
+            int c = -1;
+            if (sel.at(i).atype<char>())
+            {
+                for (int j=0; j<names.size(); j++)
+                    if (names.at(j) == sel.at(i))
+                        c = j;
+            }
+            else
+                c = sel.at(i).cast<int>();
+            if ((c < 0) || (c >= nFields))
+                throw error("csvfile::read(): no such column");
+            if (col[c] >= 0)
+                throw error("csvfile::read(): column selected twice");
+            col[c] = nCols++;
+        }
+    else
+        for (int c=0; c<nFields; c++)
+            col[c] = nCols++;
+
+    // Chunks, with boundaries just after a newline
+    int threads = 1;
+    if (attr("threads"))
+    {
+        threads = attr("threads").cast<int>();
+        if (threads <= 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<chunk<T>> chunks(threads);
+    long size = iEnd - p;
+    for (int t=0; t<threads; t++)
+    {
+        chunks[t].beg = t ? chunks[t-1].end : p;
+        const char* b = std::max(chunks[t].beg, p + size * (t+1) / threads);
+        const char* nl = (t < threads-1) && (b < iEnd)
+            ? (const char*)std::memchr(b, '\n', iEnd - b)
+            : 0;
+        chunks[t].end = nl ? nl + 1 : iEnd;
+    }
+
+    // Parse, then copy into a single view
+    std::vector<std::thread> thread;
+    for (int t=1; t<threads; t++)
+        thread.emplace_back(parse<T>, &chunks[t], &col, nCols, mDelim);
+    parse<T>(&chunks[0], &col, nCols, mDelim);
+    for (int t=1; t<threads; t++)
+        thread[t-1].join();
+    int rows = 0;
+    for (int t=0; t<threads; t++)
+    {
+        if (chunks[t].error)
+            std::rethrow_exception(chunks[t].error);
+        rows += chunks[t].rows;
+    }
+    var r = view({rows, nCols}, T(0));
+    T* d = r.ptr<T>();
+    for (int t=0; t<threads; t++)
+    {
+        std::memcpy(d, chunks[t].data.data(), chunks[t].data.size()*sizeof(T));
+        d += chunks[t].data.size();
+    }
+    return r;
+}
+
+
+var csvfile::read(var iFile)
+{
+    mDelim = attr("delimiter") ? attr("delimiter").get<char>() : 0;
+    mapped buf(iFile);
+    if (buf.size() == 0)
+        return nil;
+    const char* beg = buf.data();
+    const char* end = beg + buf.size();
+    var type = attr("type") ? attr("type") : var(0.0f);
+    switch (type.atype())
+    {
+    case TYPE_FLOAT:
+        return read<float>(beg, end);
+    case TYPE_DOUBLE:
+        return read<double>(beg, end);
+    default:
+        throw error("csvfile::read(): type must be float or double");
+    }
+}
+
+
+/**
+ * Formats the matrix into a buffer that is written out in large blocks.  The
+ * buffer is flushed before any value that might not fit in what is left.
+ */
+template<class T>
+void csvfile::write(std::ostream& iOS, var iVar)
+{
+    int rows = iVar.dim() > 1 ? iVar.shape(0) : iVar.size();
+    int cols = iVar.dim() > 1 ? iVar.shape(1) : 1;
+    const T* d = iVar.ptr<T>();
+    std::vector<char> buf(65536);
+    char* p = buf.data();
+    char* end = p + buf.size();
+    for (int i=0; i<rows; i++)
+        for (int j=0; j<cols; j++)
+        {
+            if (end - p < 64)
+            {
+                iOS.write(buf.data(), p - buf.data());
+                p = buf.data();
+            }
+            std::to_chars_result r = std::to_chars(p, end-1, d[i*cols+j]);
+            if (r.ec != std::errc())
+                throw error("csvfile::write(): can't format a number");
+            p = r.ptr;
+            *p++ = (j < cols-1) ? mDelim : '\n';
+        }
+    iOS.write(buf.data(), p - buf.data());
+}
+
+
+void csvfile::write(var iFile, var iVar)
+{
+    mDelim = attr("delimiter") ? attr("delimiter").get<char>() : ',';
+    if (iVar.dim() > 2)
+        throw error("csvfile::write(): more than two dimensions");
+    std::ofstream os(iFile.str(), std::ofstream::out);
+    if (os.fail())
+        throw error("csvfile::write(): Open failed");
+    var names = attr("names");
+    for (int i=0; i<names.size(); i++)
+        os << names.at(i).str() << (i < names.size()-1 ? mDelim : '\n');
+    switch (iVar.atype())
+    {
+    case TYPE_FLOAT:
+        write<float>(os, iVar);
+        break;
+    case TYPE_DOUBLE:
+        write<double>(os, iVar);
+        break;
+    default:
+        throw error("csvfile::write(): type must be float or double");
+    }
+    if (os.fail())
+        throw error("csvfile::write(): Write failed");
+}
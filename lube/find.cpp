@@ -0,0 +1,271 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#include <cstring>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "lube/var.h"
+#include "lube/heap.h"
+
+using namespace libube;
+
+
+/*
+ * Searching
+ *
+ * Equality of vars implies equality of type, so an element of a dense array
+ * can only equal a scalar of the same type.  Dense arrays are then searched
+ * as arrays of that type.  The loops are in blocks with no early exit so
+ * that the compiler can vectorise the compares.
+ */
+const int cBlock = 32;
+
+template<class T>
+static int find(const T* iData, int iSize, T iVal, int iFrom)
+{
+    int i = iFrom;
+    for (; i+cBlock <= iSize; i+=cBlock)
+    {
+        bool any = false;
+        for (int j=0; j<cBlock; j++)
+            any |= (iData[i+j] == iVal);
+        if (any)
+            break;
+    }
+    for (; i<iSize; i++)
+        if (iData[i] == iVal)
+            return i;
+    return -1;
+}
+
+static int find(const char* iData, int iSize, char iVal, int iFrom)
+{
+    const void* p = std::memchr(iData + iFrom, iVal, iSize - iFrom);
+    return p ? (const char*)p - iData : -1;
+}
+
+template<class T>
+static int count(const T* iData, int iSize, T iVal)
+{
+    int n = 0;
+    for (int i=0; i<iSize; i++)
+        n += (iData[i] == iVal);
+    return n;
+}
+
+
+/**
+ * Calls iFunc(data, size, value) if iVar is a dense array and iVal a scalar
+ * of the same type.  Returns false if iVar is not dense; if it is but iVal
+ * is of another type, nothing can match so iFunc is not called.
+ */
+template<class F>
+static bool dense(var iVar, var iVal, F iFunc)
+{
+    ind t = iVar.atype();
+    if (!iVar.heap() || (t == TYPE_VAR) || (t == TYPE_PAIR))
+        return false;
+    if (iVal.type() != t)
+        return true;
+    int n = iVar.size();
+    switch (t)
+    {
+    case TYPE_CHAR: iFunc(iVar.ptr<char>(), n, iVal.get<char>()); break;
+    case TYPE_INT: iFunc(iVar.ptr<int>(), n, iVal.get<int>()); break;
+    case TYPE_LONG: iFunc(iVar.ptr<long>(), n, iVal.get<long>()); break;
+    case TYPE_FLOAT: iFunc(iVar.ptr<float>(), n, iVal.get<float>()); break;
+    case TYPE_DOUBLE: iFunc(iVar.ptr<double>(), n, iVal.get<double>()); break;
+    case TYPE_CFLOAT: iFunc(iVar.ptr<cfloat>(), n, iVal.get<cfloat>()); break;
+    case TYPE_CDOUBLE:
+        iFunc(iVar.ptr<cdouble>(), n, iVal.get<cdouble>());
+        break;
+    default:
+        throw error("dense(): Unknown type");
+    }
+    return true;
+}
+
+
+/**
+ * The index of the first element equal to iVar, or -1 if there is none.  Maps
+ * are searched by key, which is a binary search.
+ */
+ind var::index(var iVar) const
+{
+    if (!defined())
+        return -1;
+    int index = -1;
+    var self = *this;
+    if (dense(self, iVar, [&](auto* iData, int iSize, auto iVal) {
+        index = find(iData, iSize, iVal, 0);
+    }))
+        return index;
+    switch (atype())
+    {
+    case TYPE_PAIR:
+    {
+        // Pairs are sorted
+        bool found;
+        index = binary(iVar, &found);
+        if (found)
+            return index;
+        break;
+    }
+    case TYPE_VAR:
+    {
+        // Nothing else is sorted; start at the beginning
+        const var* v = heap()->ptrvar();
+        for (ind i=0; i<size(); i++)
+            if (v[i] == iVar)
+                return i;
+        break;
+    }
+    default:
+        // A scalar
+        if (*this == iVar)
+            return 0;
+    }
+    return -1;
+}
+
+
+/**
+ * The indices of all the elements equal to iVar, as an int array.
+ */
+var var::indices(var iVar) const
+{
+    std::vector<int> idx;
+    var self = *this;
+    if (!dense(self, iVar, [&](auto* iData, int iSize, auto iVal) {
+        for (int i=find(iData, iSize, iVal, 0); i>=0;
+             i=find(iData, iSize, iVal, i+1))
+            idx.push_back(i);
+    }))
+    {
+        if (atype<var>())
+        {
+            const var* v = heap()->ptrvar();
+            for (int i=0; i<size(); i++)
+                if (v[i] == iVar)
+                    idx.push_back(i);
+        }
+        else
+        {
+            ind i = index(iVar);
+            if (i >= 0)
+                idx.push_back(i);
+        }
+    }
+    var r = libube::view({(int)idx.size()}, 0);
+    std::copy(idx.begin(), idx.end(), r.ptr<int>());
+    return r;
+}
+
+
+/**
+ * The number of elements equal to iVar.
+ */
+int var::count(var iVar) const
+{
+    int n = 0;
+    var self = *this;
+    if (dense(self, iVar, [&](auto* iData, int iSize, auto iVal) {
+        n = ::count(iData, iSize, iVal);
+    }))
+        return n;
+    if (atype<var>())
+    {
+        const var* v = heap()->ptrvar();
+        for (int i=0; i<size(); i++)
+            n += (v[i] == iVar);
+        return n;
+    }
+    return (index(iVar) >= 0) ? 1 : 0;
+}
+
+
+template<class T>
+static void isin(const T* iData, int iSize, var iSet, int* oIn)
+{
+    std::unordered_set<T> set(iSet.ptr<T>(), iSet.ptr<T>() + iSet.size());
+    for (int i=0; i<iSize; i++)
+        oIn[i] = set.count(iData[i]);
+}
+
+
+/**
+ * Tests each element for membership of iVar, returning an int array of 1 for
+ * those that are members and 0 otherwise.  If iVar is a map, its keys are
+ * the members; otherwise its elements are.  Rather than searching iVar for
+ * each element, its elements are put in a hash set: typed for dense arrays,
+ * of string views for strings, and otherwise of vars.
+ */
+var var::isin(var iVar) const
+{
+    int n = size();
+    var r = libube::view({n}, 0);
+    int* in = r.ptr<int>();
+    if (!n)
+        return r;
+    var self = *this;
+
+    // Maps are already sorted
+    if (iVar.heap() && iVar.atype<pair>())
+    {
+        for (int i=0; i<n; i++)
+            in[i] = (iVar.index(self.at(i)) >= 0);
+        return r;
+    }
+
+    // Dense arrays of the same (non-complex) type
+    ind t = atype();
+    if (heap() && iVar.heap() && (t == iVar.atype()))
+        switch (t)
+        {
+        case TYPE_CHAR: ::isin(self.ptr<char>(), n, iVar, in); return r;
+        case TYPE_INT: ::isin(self.ptr<int>(), n, iVar, in); return r;
+        case TYPE_LONG: ::isin(self.ptr<long>(), n, iVar, in); return r;
+        case TYPE_FLOAT: ::isin(self.ptr<float>(), n, iVar, in); return r;
+        case TYPE_DOUBLE: ::isin(self.ptr<double>(), n, iVar, in); return r;
+        default:
+            break;
+        }
+
+    // Strings, which are the usual case for arrays of vars
+    int m = iVar.size();
+    bool str = iVar.heap() && iVar.atype<var>();
+    for (int j=0; str && j<m; j++)
+        str = iVar.at(j).heap() && iVar.at(j).atype<char>();
+    if (str)
+    {
+        std::unordered_set<std::string_view> set;
+        for (int j=0; j<m; j++)
+        {
+            var s = iVar.at(j);
+            set.emplace(s.str(), s.size());
+        }
+        for (int i=0; i<n; i++)
+        {
+            var e = self.at(i);
+            in[i] = e.heap() && e.atype<char>() &&
+                set.count(std::string_view(e.str(), e.size()));
+        }
+        return r;
+    }
+
+    // Anything else
+    std::unordered_set<var> set;
+    for (int j=0; j<m; j++)
+        set.insert(iVar.at(j));
+    for (int i=0; i<n; i++)
+        in[i] = set.count(self.at(i));
+    return r;
+}
@@ -101,7 +101,18 @@ void UnaryFunctor::broadcast(var iVar, var& oVar) const
     // Call back to the unary operator
     if (mDim == 0)
     {
-        // This could be parallel!
+        // This could be parallel!  Distinct arrays of vars are passed the
+        // elements themselves rather than references to them
+        if (iVar.heap() && iVar.atype<var>() &&
+            oVar.heap() && oVar.atype<var>() &&
+            (iVar.heap() != oVar.heap()) && (iVar.size() == oVar.size()))
+        {
+            span<var> in = iVar.span<var>();
+            span<var> out = oVar.span<var>();
+            for (int i=0; i<in.size(); i++)
+                scalar(in[i], out[i]);
+            return;
+        }
         for (int i=0; i<iVar.size(); i++)
         {
             var ref = oVar.at(i);
@@ -264,6 +275,16 @@ void ArithmeticFunctor::broadcast(var iVar1, var iVar2, var& oVar) const
     if ((dim2 == 1) && (iVar2.size() == 1))
     {
         // This could be parallel!
+        if (iVar1.heap() && iVar1.atype<var>() &&
+            oVar.heap() && oVar.atype<var>() &&
+            (iVar1.heap() != oVar.heap()) && (iVar1.size() == oVar.size()))
+        {
+            span<var> in = iVar1.span<var>();
+            span<var> out = oVar.span<var>();
+            for (int i=0; i<in.size(); i++)
+                scalar(in[i], iVar2, out[i]);
+            return;
+        }
         for (int i=0; i<iVar1.size(); i++)
         {
             var tmp = oVar.at(i);
@@ -7,8 +7,8 @@
  *   Phil Garner, November 2013
  */
 
-#include <fstream>
 #include <lube/module.h>
+#include <lube/lines.h>
 
 namespace libube
 {
@@ -37,7 +37,7 @@ namespace libube
         int doContinue(int iLevel, var iToken);
 
         var mVar;
-        std::ifstream mInStream;
+        lines mLines;
         var mField;
 
         enum tokenType {
@@ -156,7 +156,7 @@ var GEDCOM::family()
 int GEDCOM::readLine()
 {
     var line;
-    if (line.getline(mInStream))
+    if (mLines.getline(line))
         mField = line.split(" ");
     else
         std::cout << "Premature end of file" << std::endl;
@@ -168,11 +168,9 @@ int GEDCOM::readLine()
 
 var GEDCOM::loadFile(var iFileName)
 {
-    mInStream.open(iFileName.str());
-    if (mInStream.fail())
-        std::cout << "Open failed" << std::endl;
+    mLines.open(iFileName);
     doFile(readLine());
-    mInStream.close();
+    mLines.close();
     return mVar;
 }
 
@@ -8,33 +8,83 @@
  */
 
 #include "lube/graph.h"
+#include <algorithm>
 #include <fstream>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
 #include <boost/graph/adjacency_list.hpp>
+#include <boost/graph/breadth_first_search.hpp>
+#include <boost/graph/compressed_sparse_row_graph.hpp>
+#include <boost/graph/depth_first_search.hpp>
+#include <boost/graph/dijkstra_shortest_paths.hpp>
 #include <boost/graph/graphviz.hpp>
+#include <boost/graph/reverse_graph.hpp>
+#include <boost/graph/strong_components.hpp>
+#include <boost/graph/topological_sort.hpp>
+#include <boost/pending/disjoint_sets.hpp>
+#include <boost/property_map/property_map.hpp>
 
 namespace libube
 {
+    /** Edge properties */
+    struct arc
+    {
+        double weight = 1.0;
+    };
+
     typedef boost::adjacency_list<
         boost::vecS,
         boost::vecS,
         boost::bidirectionalS,
         var,
-        var
+        arc
         >
     adjacency_list;
     typedef boost::graph_traits<adjacency_list>::vertex_descriptor vertex;
     typedef boost::graph_traits<adjacency_list>::edge_descriptor edge;
 
+    /** The frozen form; vertices are still numbered the same */
+    typedef boost::compressed_sparse_row_graph<
+        boost::bidirectionalS,
+        var,
+        arc
+        >
+    csr_graph;
+
     /** Concrete implementation of graph module */
     class Graph : public graph
     {
     public:
         Graph(var iArg) {};
         void addEdge(ind iVertex1, ind iVertex2);
+        void addEdge(ind iVertex1, ind iVertex2, double iWeight);
+        void addEdges(var iFrom, var iTo, var iWeight);
         ind addVertex();
+        ind vertices();
+        ind edges();
+        void freeze();
+        var bfs(ind iVertex);
+        var dfs(ind iVertex);
+        var distance(ind iVertex);
+        var shortestPath(ind iFrom, ind iTo);
+        var components(bool iStrong);
+        var topologicalSort();
+        var ancestors(ind iVertex);
+        var descendants(ind iVertex);
         void writeGraphViz(var iFileName);
     private:
         adjacency_list mGraph;
+        std::unique_ptr<csr_graph> mCSR;
+        void thaw();
+        void check(ind iVertex);
+
+        /** Calls iFunc with whichever form the graph is in */
+        template<class F>
+        auto apply(F iFunc) {
+            return mCSR ? iFunc(*mCSR) : iFunc(mGraph);
+        }
     };
 
     /** Factory function to create a class */
@@ -46,25 +96,410 @@ namespace libube
 
 using namespace libube;
 
+
+/** Copies a vertex list into an int array, nil if it's empty */
+static var array(const std::vector<int>& iList)
+{
+    if (iList.empty())
+        return nil;
+    var r = view({(int)iList.size()}, 0);
+    std::copy(iList.begin(), iList.end(), r.ptr<int>());
+    return r;
+}
+
+
+/**
+ * Reads an array of vertices or weights into a vector.  Otherwise typed
+ * elements are cast to long or double, there being no cast to every T.
+ */
+template<class T>
+static std::vector<T> vector(var iVar)
+{
+    std::vector<T> r(iVar.size());
+    switch (iVar.atype())
+    {
+    case TYPE_INT:
+        std::copy(iVar.ptr<int>(), iVar.ptr<int>() + r.size(), r.begin());
+        break;
+    case TYPE_LONG:
+        std::copy(iVar.ptr<long>(), iVar.ptr<long>() + r.size(), r.begin());
+        break;
+    case TYPE_DOUBLE:
+        std::copy(
+            iVar.ptr<double>(), iVar.ptr<double>() + r.size(), r.begin()
+        );
+        break;
+    default:
+        for (size_t i=0; i<r.size(); i++)
+            r[i] = std::is_floating_point<T>::value
+                ? (T)iVar.at(i).cast<double>()
+                : (T)iVar.at(i).cast<long>();
+    }
+    return r;
+}
+
+
+/** Records the vertices in the order a search discovers them */
+class recorder : public boost::default_bfs_visitor
+{
+public:
+    recorder(std::vector<int>& oList) : mList(oList) {}
+    template<class V, class G>
+    void discover_vertex(V iV, const G&) { mList.push_back(iV); }
+private:
+    std::vector<int>& mList;
+};
+
+class dfs_recorder : public boost::default_dfs_visitor
+{
+public:
+    dfs_recorder(std::vector<int>& oList) : mList(oList) {}
+    template<class V, class G>
+    void discover_vertex(V iV, const G&) { mList.push_back(iV); }
+private:
+    std::vector<int>& mList;
+};
+
+
+/** Vertices reachable from iVertex, in the order discovered */
+template<class G>
+static std::vector<int> bfs(const G& iG, ind iVertex)
+{
+    std::vector<int> list;
+    std::vector<boost::default_color_type> color(num_vertices(iG));
+    boost::breadth_first_visit(
+        iG, iVertex,
+        boost::visitor(recorder(list)).color_map(
+            boost::make_iterator_property_map(
+                color.begin(), get(boost::vertex_index, iG)
+            )
+        )
+    );
+    return list;
+}
+
+
+template<class G>
+static std::vector<int> dfs(const G& iG, ind iVertex)
+{
+    std::vector<int> list;
+    std::vector<boost::default_color_type> color(num_vertices(iG));
+    boost::depth_first_visit(
+        iG, iVertex, dfs_recorder(list),
+        boost::make_iterator_property_map(
+            color.begin(), get(boost::vertex_index, iG)
+        )
+    );
+    return list;
+}
+
+
+/** Vertices reachable from iVertex, other than itself, in vertex order */
+template<class G>
+static var reachable(const G& iG, ind iVertex)
+{
+    std::vector<int> list = bfs(iG, iVertex);
+    list.erase(list.begin());
+    std::sort(list.begin(), list.end());
+    return array(list);
+}
+
+
+/**
+ * Dijkstra from iVertex; fills the distances and the predecessors.
+ */
+template<class G>
+static void dijkstra(
+    const G& iG, ind iVertex,
+    std::vector<double>& oDist, std::vector<vertex>& oPred
+)
+{
+    oDist.resize(num_vertices(iG));
+    oPred.resize(num_vertices(iG));
+    boost::dijkstra_shortest_paths(
+        iG, iVertex,
+        boost::weight_map(get(&arc::weight, iG))
+        .distance_map(
+            boost::make_iterator_property_map(
+                oDist.begin(), get(boost::vertex_index, iG)
+            )
+        )
+        .predecessor_map(
+            boost::make_iterator_property_map(
+                oPred.begin(), get(boost::vertex_index, iG)
+            )
+        )
+        .distance_inf(std::numeric_limits<double>::infinity())
+    );
+}
+
+
+/** Weakly connected components, by union-find over the edges */
+template<class G>
+static std::vector<int> weak(const G& iG)
+{
+    size_t n = num_vertices(iG);
+    std::vector<int> rank(n);
+    std::vector<vertex> parent(n);
+    typedef boost::iterator_property_map<
+        std::vector<int>::iterator, boost::identity_property_map
+    > rank_map;
+    typedef boost::iterator_property_map<
+        std::vector<vertex>::iterator, boost::identity_property_map
+    > parent_map;
+    boost::disjoint_sets<rank_map, parent_map> sets(
+        rank_map(rank.begin()), parent_map(parent.begin())
+    );
+    for (size_t v=0; v<n; v++)
+        sets.make_set(v);
+    typename boost::graph_traits<G>::edge_iterator e, end;
+    for (boost::tie(e, end) = boost::edges(iG); e != end; e++)
+        sets.union_set(source(*e, iG), target(*e, iG));
+
+    // Number the components in order of their first vertex
+    std::vector<int> label(n, -1);
+    std::vector<int> comp(n);
+    int next = 0;
+    for (size_t v=0; v<n; v++)
+    {
+        vertex r = sets.find_set(v);
+        if (label[r] < 0)
+            label[r] = next++;
+        comp[v] = label[r];
+    }
+    return comp;
+}
+
+
+template<class G>
+static std::vector<int> strong(const G& iG)
+{
+    std::vector<int> comp(num_vertices(iG));
+    boost::strong_components(
+        iG, boost::make_iterator_property_map(
+            comp.begin(), get(boost::vertex_index, iG)
+        )
+    );
+    return comp;
+}
+
+
+template<class G>
+static std::vector<int> topological(const G& iG)
+{
+    std::vector<vertex> order;
+    boost::topological_sort(iG, std::back_inserter(order));
+    return std::vector<int>(order.rbegin(), order.rend());
+}
+
+
+/** Throws if the graph is frozen */
+void Graph::thaw()
+{
+    if (mCSR)
+        throw error("Graph: can't add to a frozen graph");
+}
+
+
+void Graph::check(ind iVertex)
+{
+    if ((iVertex < 0) || (iVertex >= vertices()))
+        throw error("Graph: no such vertex");
+}
+
+
 void Graph::addEdge(ind iVertex1, ind iVertex2)
+{
+    addEdge(iVertex1, iVertex2, 1.0);
+}
+
+
+void Graph::addEdge(ind iVertex1, ind iVertex2, double iWeight)
 {
     // An edge is some non-trivial thing; it does ot cast to an integer type
+    thaw();
     std::pair<edge, bool> ret;
-    ret = add_edge(iVertex1, iVertex2, mGraph);
+    ret = add_edge(iVertex1, iVertex2, arc{iWeight}, mGraph);
 }
 
+
+/**
+ * Adds the edges iFrom[i] -> iTo[i], with weights iWeight[i] if given.  The
+ * out-edge list of each source is reserved up front, so each grows once.
+ */
+void Graph::addEdges(var iFrom, var iTo, var iWeight)
+{
+    thaw();
+    if (iFrom.size() != iTo.size())
+        throw error("Graph::addEdges(): arrays differ in size");
+    if (iWeight && (iWeight.size() != iFrom.size()))
+        throw error("Graph::addEdges(): weights differ in size");
+    std::vector<ind> from = vector<ind>(iFrom);
+    std::vector<ind> to = vector<ind>(iTo);
+    std::vector<double> weight;
+    if (iWeight)
+        weight = vector<double>(iWeight);
+
+    ind n = num_vertices(mGraph);
+    for (size_t i=0; i<from.size(); i++)
+    {
+        if ((from[i] < 0) || (to[i] < 0))
+            throw error("Graph::addEdges(): negative vertex");
+        n = std::max<ind>(n, std::max(from[i], to[i]) + 1);
+    }
+    while ((ind)num_vertices(mGraph) < n)
+        add_vertex(mGraph);
+    std::vector<ind> degree(n);
+    for (size_t i=0; i<from.size(); i++)
+        degree[from[i]]++;
+    for (ind v=0; v<n; v++)
+        if (degree[v])
+            mGraph.out_edge_list(v).reserve(out_degree(v, mGraph) + degree[v]);
+    for (size_t i=0; i<from.size(); i++)
+        add_edge(
+            from[i], to[i], arc{weight.size() ? weight[i] : 1.0}, mGraph
+        );
+}
+
+
 ind Graph::addVertex()
 {
     // A vertex is just an index; at least, it can be cast to an ind.  So we
     // can return an ind
+    thaw();
     vertex v = add_vertex(mGraph);
     return v;
 }
 
+
+ind Graph::vertices()
+{
+    return apply([](auto& g) { return (ind)num_vertices(g); });
+}
+
+
+ind Graph::edges()
+{
+    return apply([](auto& g) { return (ind)num_edges(g); });
+}
+
+
+/**
+ * Converts the graph to compressed sparse row form.  The vertex properties
+ * and edge weights are kept; the edges out of each vertex stay in the order
+ * they were added.
+ */
+void Graph::freeze()
+{
+    if (mCSR)
+        return;
+    std::vector< std::pair<vertex, vertex> > pairs;
+    std::vector<arc> arcs;
+    pairs.reserve(num_edges(mGraph));
+    arcs.reserve(num_edges(mGraph));
+    boost::graph_traits<adjacency_list>::edge_iterator e, end;
+    for (boost::tie(e, end) = boost::edges(mGraph); e != end; e++)
+    {
+        pairs.emplace_back(source(*e, mGraph), target(*e, mGraph));
+        arcs.push_back(mGraph[*e]);
+    }
+    ind n = num_vertices(mGraph);
+    mCSR.reset(new csr_graph(
+        boost::edges_are_unsorted_multi_pass,
+        pairs.begin(), pairs.end(), arcs.begin(), n
+    ));
+    for (ind v=0; v<n; v++)
+        (*mCSR)[v] = mGraph[v];
+    mGraph.clear();
+}
+
+
+var Graph::bfs(ind iVertex)
+{
+    check(iVertex);
+    return array(apply([&](auto& g) { return ::bfs(g, iVertex); }));
+}
+
+
+var Graph::dfs(ind iVertex)
+{
+    check(iVertex);
+    return array(apply([&](auto& g) { return ::dfs(g, iVertex); }));
+}
+
+
+var Graph::distance(ind iVertex)
+{
+    check(iVertex);
+    std::vector<double> dist;
+    std::vector<vertex> pred;
+    apply([&](auto& g) { dijkstra(g, iVertex, dist, pred); return 0; });
+    var r = view({(int)dist.size()}, 0.0);
+    std::copy(dist.begin(), dist.end(), r.ptr<double>());
+    return r;
+}
+
+
+var Graph::shortestPath(ind iFrom, ind iTo)
+{
+    check(iFrom);
+    check(iTo);
+    std::vector<double> dist;
+    std::vector<vertex> pred;
+    apply([&](auto& g) { dijkstra(g, iFrom, dist, pred); return 0; });
+    if (dist[iTo] == std::numeric_limits<double>::infinity())
+        return nil;
+    std::vector<int> path;
+    for (vertex v=iTo; v!=(vertex)iFrom; v=pred[v])
+        path.push_back(v);
+    path.push_back(iFrom);
+    std::reverse(path.begin(), path.end());
+    return array(path);
+}
+
+
+var Graph::components(bool iStrong)
+{
+    return array(apply([&](auto& g) {
+        return iStrong ? strong(g) : weak(g);
+    }));
+}
+
+
+var Graph::topologicalSort()
+{
+    try
+    {
+        return array(apply([](auto& g) { return topological(g); }));
+    }
+    catch (boost::not_a_dag&)
+    {
+        throw error("Graph::topologicalSort(): graph has a cycle");
+    }
+}
+
+
+var Graph::ancestors(ind iVertex)
+{
+    check(iVertex);
+    return apply([&](auto& g) {
+        return reachable(boost::make_reverse_graph(g), iVertex);
+    });
+}
+
+
+var Graph::descendants(ind iVertex)
+{
+    check(iVertex);
+    return apply([&](auto& g) { return reachable(g, iVertex); });
+}
+
+
+template<class G>
 class LabelWriter
 {
 public:
-    LabelWriter(adjacency_list& iGraph) : mGraph(iGraph) {}
+    LabelWriter(G& iGraph) : mGraph(iGraph) {}
     template <class VertexOrEdge>
     void operator()(std::ostream& iOut, const VertexOrEdge& iV) const
     {
@@ -76,12 +511,15 @@ public:
                  << "\"]";
     }
 private:
-    adjacency_list& mGraph;
+    G& mGraph;
 };
 
 void Graph::writeGraphViz(var iFileName)
 {
     std::ofstream ofs(iFileName.str(), std::ofstream::out);
-    LabelWriter lw(mGraph);
-    write_graphviz(ofs, mGraph, lw);
+    apply([&](auto& g) {
+        LabelWriter<std::remove_reference_t<decltype(g)>> lw(g);
+        write_graphviz(ofs, g, lw);
+        return 0;
+    });
 }
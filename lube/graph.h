@@ -14,12 +14,42 @@
 
 namespace libube
 {
-    /** Virtual interface to graph module */
+    /**
+     * Virtual interface to graph module
+     *
+     * The graph is directed, with vertices numbered from zero.  Edges have a
+     * weight, default one, that is used by the shortest path methods.  The
+     * edges can be added in bulk from arrays of source and target vertices;
+     * vertices are created as necessary.  Once built, freeze() converts the
+     * graph to compressed sparse row form, which is smaller and faster to
+     * traverse, but to which nothing can be added.
+     *
+     * Methods returning sets of vertices return int arrays.  bfs() and dfs()
+     * return the vertices reachable from iVertex in the order discovered;
+     * ancestors() and descendants() return the vertices from which iVertex
+     * can be reached, and that can be reached from it, in vertex order.
+     * components() returns the component of each vertex, weak or strong.
+     * distance() returns the distance to each vertex, infinite if it can't
+     * be reached, and shortestPath() the vertices along the way, or nil.
+     */
     class graph : public Module
     {
     public:
         virtual void addEdge(ind iVertex1, ind iVertex2) = 0;
+        virtual void addEdge(ind iVertex1, ind iVertex2, double iWeight) = 0;
+        virtual void addEdges(var iFrom, var iTo, var iWeight=nil) = 0;
         virtual ind addVertex() = 0;
+        virtual ind vertices() = 0;
+        virtual ind edges() = 0;
+        virtual void freeze() = 0;
+        virtual var bfs(ind iVertex) = 0;
+        virtual var dfs(ind iVertex) = 0;
+        virtual var distance(ind iVertex) = 0;
+        virtual var shortestPath(ind iFrom, ind iTo) = 0;
+        virtual var components(bool iStrong=false) = 0;
+        virtual var topologicalSort() = 0;
+        virtual var ancestors(ind iVertex) = 0;
+        virtual var descendants(ind iVertex) = 0;
         virtual void writeGraphViz(var iFileName) = 0;
      };
 
@@ -0,0 +1,493 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "lube/var.h"
+#include "lube/heap.h"
+#include "lube/hash.h"
+
+using namespace libube;
+
+
+
+/*
+ * The hash of a var
+ *
+ * The bytes of a value go through four independent lanes of 64 bit
+ * multiply-rotate steps, the rounds of xxHash, so long strings are not held
+ * up by a single dependency chain.  The input can be given in pieces, and the
+ * result is the same as for the whole.
+ *
+ * Equal vars must hash equal.  Equality implies the same type and size, and
+ * elements are compared by value, so an array of vars can equal a dense
+ * array.  Hence the elements of any array are hashed as the bytes of their
+ * values, with nested arrays as their own hash; only the values of maps are
+ * compared, so only they are hashed.
+ */
+const uint64_t cPrime1 = 0x9e3779b185ebca87ULL;
+const uint64_t cPrime2 = 0xc2b2ae3d27d4eb4fULL;
+
+static inline uint64_t rotl(uint64_t iX, int iR)
+{
+    return (iX << iR) | (iX >> (64 - iR));
+}
+
+static inline uint64_t step(uint64_t iAcc, uint64_t iWord)
+{
+    return rotl(iAcc + iWord * cPrime2, 31) * cPrime1;
+}
+
+static inline uint64_t load(const unsigned char* iData)
+{
+    uint64_t w;
+    std::memcpy(&w, iData, sizeof(w));
+    return w;
+}
+
+namespace
+{
+    class hasher
+    {
+    public:
+        hasher(uint64_t iSeed);
+        void add(const void* iData, size_t iSize);
+        uint64_t result() const;
+    private:
+        uint64_t mLane[4];
+        uint64_t mWords;
+        uint64_t mBytes;
+        unsigned char mTail[8];
+        int mNTail;
+        void word(uint64_t iWord) {
+            mLane[mWords & 3] = step(mLane[mWords & 3], iWord);
+            mWords++;
+        };
+    };
+}
+
+hasher::hasher(uint64_t iSeed)
+{
+    mLane[0] = iSeed + cPrime1 + cPrime2;
+    mLane[1] = iSeed + cPrime2;
+    mLane[2] = iSeed;
+    mLane[3] = iSeed - cPrime1;
+    mWords = 0;
+    mBytes = 0;
+    mNTail = 0;
+}
+
+void hasher::add(const void* iData, size_t iSize)
+{
+    const unsigned char* p = (const unsigned char*)iData;
+    mBytes += iSize;
+
+    // Complete a partial word
+    while (mNTail && iSize)
+    {
+        mTail[mNTail++] = *p++;
+        iSize--;
+        if (mNTail == 8)
+        {
+            word(load(mTail));
+            mNTail = 0;
+        }
+    }
+
+    // Get to the first lane, then do all four at once
+    while ((iSize >= 8) && (mWords & 3))
+    {
+        word(load(p));
+        p += 8;
+        iSize -= 8;
+    }
+    while (iSize >= 32)
+    {
+        mLane[0] = step(mLane[0], load(p));
+        mLane[1] = step(mLane[1], load(p+8));
+        mLane[2] = step(mLane[2], load(p+16));
+        mLane[3] = step(mLane[3], load(p+24));
+        mWords += 4;
+        p += 32;
+        iSize -= 32;
+    }
+    while (iSize >= 8)
+    {
+        word(load(p));
+        p += 8;
+        iSize -= 8;
+    }
+
+    // Keep what's left
+    std::memcpy(mTail + mNTail, p, iSize);
+    mNTail += iSize;
+}
+
+uint64_t hasher::result() const
+{
+    uint64_t h =
+        rotl(mLane[0], 1) + rotl(mLane[1], 7) +
+        rotl(mLane[2], 12) + rotl(mLane[3], 18);
+    uint64_t t = 0;
+    std::memcpy(&t, mTail, mNTail);
+    h = rotl(h ^ step(0, t), 27) * cPrime1 + mBytes;
+
+    // The finaliser of MurmurHash3
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+
+/** Zeros compare equal whatever their sign, so must hash equal */
+template<class T>
+static inline T canon(T iVal) { return iVal; }
+static inline float canon(float iVal) { return iVal == 0.0f ? 0.0f : iVal; }
+static inline double canon(double iVal) { return iVal == 0.0 ? 0.0 : iVal; }
+static inline cfloat canon(cfloat iVal) {
+    return cfloat(canon(iVal.real()), canon(iVal.imag()));
+}
+static inline cdouble canon(cdouble iVal) {
+    return cdouble(canon(iVal.real()), canon(iVal.imag()));
+}
+
+template<class T>
+static void scalar(hasher& ioHash, T iVal)
+{
+    T v = canon(iVal);
+    ioHash.add(&v, sizeof(T));
+}
+
+/** Dense arrays go in blocks so that zeros can be normalised on the way */
+template<class T>
+static void dense(hasher& ioHash, const T* iData, int iSize)
+{
+    const int block = 64;
+    T buf[block];
+    for (int i=0; i<iSize; i+=block)
+    {
+        int n = std::min(block, iSize-i);
+        for (int j=0; j<n; j++)
+            buf[j] = canon(iData[i+j]);
+        ioHash.add(buf, n*sizeof(T));
+    }
+}
+
+static void dense(hasher& ioHash, const char* iData, int iSize)
+{
+    ioHash.add(iData, iSize);
+}
+
+static void dense(hasher& ioHash, const int* iData, int iSize)
+{
+    ioHash.add(iData, iSize*sizeof(int));
+}
+
+static void dense(hasher& ioHash, const long* iData, int iSize)
+{
+    ioHash.add(iData, iSize*sizeof(long));
+}
+
+
+/**
+ * Adds the value of an element of an array.  Arrays are added as their hash,
+ * and undefined elements as a zero byte, which is distinct from no element.
+ */
+static void element(hasher& ioHash, const var& iVar)
+{
+    if (iVar.heap())
+    {
+        uint64_t h = iVar.hash();
+        ioHash.add(&h, sizeof(h));
+        return;
+    }
+    switch (iVar.type())
+    {
+    case TYPE_CHAR: scalar(ioHash, iVar.get<char>()); break;
+    case TYPE_INT: scalar(ioHash, iVar.get<int>()); break;
+    case TYPE_LONG: scalar(ioHash, iVar.get<long>()); break;
+    case TYPE_FLOAT: scalar(ioHash, iVar.get<float>()); break;
+    case TYPE_DOUBLE: scalar(ioHash, iVar.get<double>()); break;
+    case TYPE_CFLOAT: scalar(ioHash, iVar.get<cfloat>()); break;
+    case TYPE_CDOUBLE: scalar(ioHash, iVar.get<cdouble>()); break;
+    default:
+    {
+        char z = 0;
+        ioHash.add(&z, 1);
+    }
+    }
+}
+
+
+/**
+ * Returns a hash of the value, consistent with operator==().  Scalars are
+ * seeded with their type; arrays, including strings, views and nested arrays,
+ * with TYPE_ARRAY.
+ */
+size_t var::hash() const
+{
+    hasher h(type());
+    IHeap* hp = heap();
+    if (!hp)
+    {
+        if (defined())
+            element(h, *this);
+        return h.result();
+    }
+
+    // The heap's size, rather than the var's, is the whole of a view
+    int n = hp->size();
+    switch (hp->type())
+    {
+    case TYPE_CHAR: dense(h, hp->ptrchar(), n); break;
+    case TYPE_INT: dense(h, hp->ptrint(), n); break;
+    case TYPE_LONG: dense(h, hp->ptrlong(), n); break;
+    case TYPE_FLOAT: dense(h, hp->ptrfloat(), n); break;
+    case TYPE_DOUBLE: dense(h, hp->ptrdouble(), n); break;
+    case TYPE_CFLOAT: dense(h, hp->ptrcfloat(), n); break;
+    case TYPE_CDOUBLE: dense(h, hp->ptrcdouble(), n); break;
+    case TYPE_VAR:
+        for (int i=0; i<n; i++)
+            element(h, *hp->ptrvar(i));
+        break;
+    case TYPE_PAIR:
+        for (int i=0; i<n; i++)
+            element(h, hp->ptrpair(i)->val);
+        break;
+    default:
+        throw error("var::hash(): Unknown type");
+    }
+    return h.result();
+}
+
+
+/*
+ * varmap
+ */
+const int cEmpty = -1;
+const int cDeleted = -2;
+
+varmap::varmap(int iSize)
+{
+    mSize = 0;
+    mUsed = 0;
+    reserve(iSize);
+}
+
+
+/**
+ * Makes room for iSize entries without growing the table.
+ */
+void varmap::reserve(int iSize)
+{
+    int cap = 8;
+    while (cap*3 < iSize*4)
+        cap *= 2;
+    if (cap > (int)mSlot.size())
+        rehash(cap);
+    mEntry.reserve(iSize);
+}
+
+
+void varmap::clear()
+{
+    mEntry.clear();
+    std::fill(mSlot.begin(), mSlot.end(), cEmpty);
+    mSize = 0;
+    mUsed = 0;
+}
+
+
+/**
+ * The slot holding iKey, or, if it is not there, the empty slot that ends
+ * its probe sequence.
+ */
+int varmap::lookup(const var& iKey, size_t iHash) const
+{
+    size_t mask = mSlot.size() - 1;
+    for (size_t i=iHash & mask; ; i=(i+1) & mask)
+    {
+        int e = mSlot[i];
+        if (e == cEmpty)
+            return i;
+        if ((e != cDeleted) && (mEntry[e].hash == iHash) &&
+            (mEntry[e].key == iKey))
+            return i;
+    }
+}
+
+
+/**
+ * Re-builds the table with iCapacity slots, dropping deleted entries.
+ */
+void varmap::rehash(int iCapacity)
+{
+    if (mSize < (int)mEntry.size())
+    {
+        int j = 0;
+        for (size_t i=0; i<mEntry.size(); i++)
+            if (mEntry[i].live)
+            {
+                if (j != (int)i)
+                    mEntry[j] = mEntry[i];
+                j++;
+            }
+        mEntry.resize(j);
+    }
+    mSlot.assign(iCapacity, cEmpty);
+    size_t mask = iCapacity - 1;
+    for (size_t e=0; e<mEntry.size(); e++)
+    {
+        size_t i = mEntry[e].hash & mask;
+        while (mSlot[i] != cEmpty)
+            i = (i+1) & mask;
+        mSlot[i] = e;
+    }
+    mUsed = mEntry.size();
+}
+
+
+/**
+ * The value at iKey, inserting an undefined one if the key is new.
+ */
+var& varmap::operator [](var iKey)
+{
+    // A reference (to an element of an array) has to become a value
+    iKey.dereference();
+    size_t h = iKey.hash();
+    int s = lookup(iKey, h);
+    if (mSlot[s] != cEmpty)
+        return mEntry[mSlot[s]].val;
+
+    // Keep the load under three quarters
+    if ((mUsed+1)*4 > (int)mSlot.size()*3)
+    {
+        int cap = mSlot.size();
+        while ((mSize+1)*2 > cap)
+            cap *= 2;
+        rehash(cap);
+        s = lookup(iKey, h);
+    }
+    mSlot[s] = mEntry.size();
+    mEntry.push_back({h, iKey, nil, true});
+    mSize++;
+    mUsed++;
+    return mEntry.back().val;
+}
+
+
+/**
+ * A pointer to the value at iKey, or null if there is no such key.
+ */
+var* varmap::find(var iKey)
+{
+    int s = lookup(iKey, iKey.hash());
+    return (mSlot[s] == cEmpty) ? 0 : &mEntry[mSlot[s]].val;
+}
+
+
+bool varmap::contains(var iKey) const
+{
+    return mSlot[lookup(iKey, iKey.hash())] != cEmpty;
+}
+
+
+/**
+ * Removes iKey, returning whether it was there.  The slot is marked deleted
+ * so that probe sequences through it still work.
+ */
+bool varmap::erase(var iKey)
+{
+    int s = lookup(iKey, iKey.hash());
+    if (mSlot[s] == cEmpty)
+        return false;
+    entry& e = mEntry[mSlot[s]];
+    e.key.clear();
+    e.val.clear();
+    e.live = false;
+    mSlot[s] = cDeleted;
+    mSize--;
+    return true;
+}
+
+
+var varmap::keys() const
+{
+    var r;
+    r.presize(mSize);
+    for (size_t i=0; i<mEntry.size(); i++)
+        if (mEntry[i].live)
+            r.push(mEntry[i].key);
+    return r;
+}
+
+
+var varmap::values() const
+{
+    var r;
+    r.presize(mSize);
+    for (size_t i=0; i<mEntry.size(); i++)
+        if (mEntry[i].live)
+            r.push(mEntry[i].val);
+    return r;
+}
+
+
+/**
+ * Returns the one string per thread equal to iStr, adding a copy of iStr if
+ * there is none.  Interned strings share their storage, so take less memory
+ * and compare equal at once, but must not then be modified in place.  The
+ * table is per thread as reference counts are not atomic; for the same
+ * reason, anything holding interned strings must stay in the thread that
+ * interned them.
+ */
+var libube::intern(var iStr)
+{
+    static thread_local varmap table;
+    var* p = table.find(iStr);
+    if (p)
+        return *p;
+    var s = iStr.copy();
+    table[s] = s;
+    return s;
+}
+
+
+/*
+ * varset
+ */
+varset::varset(var iVar)
+{
+    if (!iVar)
+        return;
+    int n = iVar.size();
+    reserve(n);
+    if (iVar.heap() && iVar.atype<var>())
+        for (int i=0; i<n; i++)
+            insert(*iVar.heap()->ptrvar(i));
+    else
+        for (int i=0; i<n; i++)
+            insert(iVar.at(i));
+}
+
+
+/**
+ * Inserts iVar, returning whether it was new.
+ */
+bool varset::insert(var iVar)
+{
+    int n = size();
+    mMap[iVar];
+    return size() > n;
+}
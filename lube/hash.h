@@ -0,0 +1,78 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <vector>
+#include <lube/var.h>
+
+namespace libube
+{
+    /**
+     * Hash map keyed by var
+     *
+     * Open addressing with linear probing into a table of entry indices.  The
+     * entries themselves are kept in insertion order, so keys() and values()
+     * come out in that order.  Each entry keeps the hash of its key, so the
+     * table can grow without re-hashing.  As for a std::vector, the reference
+     * returned by operator[]() is only good until the next insertion.
+     */
+    class varmap
+    {
+    public:
+        varmap(int iSize=0);
+        int size() const { return mSize; };
+        void reserve(int iSize);
+        void clear();
+        var& operator [](var iKey);
+        var* find(var iKey);
+        bool contains(var iKey) const;
+        bool erase(var iKey);
+        var keys() const;
+        var values() const;
+    private:
+        struct entry
+        {
+            size_t hash;
+            var key;
+            var val;
+            bool live;
+        };
+        std::vector<entry> mEntry; ///< Entries in insertion order
+        std::vector<int> mSlot;    ///< Entry index, or empty or deleted
+        int mSize;                 ///< Live entries
+        int mUsed;                 ///< Slots that are not empty
+        int lookup(const var& iKey, size_t iHash) const;
+        void rehash(int iCapacity);
+    };
+
+    /**
+     * Hash set of vars
+     *
+     * A varmap with no values.  Constructed from an array, it holds the
+     * distinct elements, so keys() returns them in order of first appearance.
+     */
+    class varset
+    {
+    public:
+        varset(var iVar=nil);
+        int size() const { return mMap.size(); };
+        void reserve(int iSize) { mMap.reserve(iSize); };
+        void clear() { mMap.clear(); };
+        bool insert(var iVar);
+        bool contains(var iVar) const { return mMap.contains(iVar); };
+        bool erase(var iVar) { return mMap.erase(iVar); };
+        var keys() const { return mMap.keys(); };
+    private:
+        varmap mMap;
+    };
+}
+
+#endif // HASH_H
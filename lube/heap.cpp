@@ -43,6 +43,7 @@ Heap::Heap()
     mData.vp = 0;
     mSize = 0;
     mCapacity = 0;
+    mHead = 0;
     mRefCount = 0;
     mType = TYPE_VAR;
 }
@@ -216,7 +217,7 @@ int Heap::detach()
     int count = --mRefCount;
     if (count == 0)
     {
-        dealloc(mData);
+        dealloc(base());
         delete this;
     }
     return count;
@@ -240,27 +241,15 @@ void Heap::resize(int iSize)
         alloc(mCapacity);
     }
 
-    // Allocated
-    else
+    // Allocated, but no room after the head
+    else if (mHead + iSize > mCapacity)
     {
-        // Re-alloc.
+        // Re-alloc.  If at least half would be free then the room is at the
+        // front, so keep the size; otherwise grow.
         int newSize = allocSize(iSize);
-        if (mCapacity < newSize)
-        {
-            dataType old = mData;
-            alloc(newSize);
-            int toCopy = std::min(mCapacity, newSize);
-            if (mType == TYPE_VAR)
-                for (int i=0; i<toCopy; i++)
-                    mData.vp[i] = old.vp[i];
-            else if (mType == TYPE_PAIR)
-                for (int i=0; i<toCopy; i++)
-                    mData.pp[i] = old.pp[i];
-            else
-                std::memcpy(mData.cp, old.cp, sizeOf(mType)*toCopy);
-            dealloc(old);
-            mCapacity = newSize;
-        }
+        if (newSize <= mCapacity)
+            newSize = (iSize*2 <= mCapacity) ? mCapacity : mCapacity*2;
+        relocate(newSize, 0);
     }
 
     // Put in the null terminator
@@ -271,6 +260,43 @@ void Heap::resize(int iSize)
 }
 
 
+/**
+ * The start of the allocation, which is mHead elements before the data.
+ */
+Heap::dataType Heap::base() const
+{
+    dataType b = mData;
+    if (mHead)
+        b.cp -= mHead*sizeOf(mType);
+    return b;
+}
+
+
+/**
+ * Move the array to a new allocation of iCapacity elements, starting iHead
+ * elements in.  As much of the old allocation as fits is carried over.
+ */
+void Heap::relocate(int iCapacity, int iHead)
+{
+    dataType old = mData;
+    dataType oldBase = base();
+    int toCopy = std::min(mCapacity - mHead, iCapacity - iHead);
+    alloc(iCapacity);
+    mData.cp += iHead*sizeOf(mType);
+    if (mType == TYPE_VAR)
+        for (int i=0; i<toCopy; i++)
+            mData.vp[i] = old.vp[i];
+    else if (mType == TYPE_PAIR)
+        for (int i=0; i<toCopy; i++)
+            mData.pp[i] = old.pp[i];
+    else
+        std::memcpy(mData.cp, old.cp, sizeOf(mType)*toCopy);
+    dealloc(oldBase);
+    mCapacity = iCapacity;
+    mHead = iHead;
+}
+
+
 /**
  * Copy the data of an array
  *
@@ -445,84 +471,67 @@ var& Heap::key(int iIndex)
 }
 
 
-bool Heap::neq(IHeap* iHeap)
-{
-    for (int i=0; i<mSize; i++)
-        if (at(i) != iHeap->at(i))
-            return true;
-    return false;
-}
-
-
-bool Heap::lt(IHeap* iHeap)
-{
-    if ( (mType == TYPE_CHAR) && (iHeap->type() == TYPE_CHAR) )
-        return (std::strcmp(ptrchar(), iHeap->ptrchar()) < 0);
-    for (int i=0; i<std::min(size(), iHeap->size()); i++)
-        if (at(i) < iHeap->at(i))
-            return true;
-    return false;
-}
-
-
 /**
  * Shift the array contents down (backwards), returning the lowest indexed
- * element that would have fallen off the bottom (front).
+ * element that would have fallen off the bottom (front).  Rather than moving
+ * the contents, the start of the array moves up.
  */
 var Heap::shift()
 {
-    // Move syntax is memmove(dest, src, n)
-    //
-    // var and pair use placement delete on the overwritten element (to delete
-    // it) and placement new on the exposed one (to reset it, rather than
-    // actually construct a new one).
+    if (mSize == 0)
+        throw std::range_error("Heap::shift(): array is empty");
+
+    // var and pair use placement delete on the element (to delete it) and
+    // placement new (to reset it, rather than actually construct a new one),
+    // so the space in front of the array holds only default elements.
     var r;
     switch (mType)
     {
     case TYPE_CHAR:
         r = mData.cp[0];
-        memmove(mData.cp, mData.cp+1, (mSize-1)*sizeof(char));
         break;
     case TYPE_INT:
         r = mData.ip[0];
-        memmove(mData.ip, mData.ip+1, (mSize-1)*sizeof(int));
         break;
     case TYPE_LONG:
         r = mData.lp[0];
-        memmove(mData.lp, mData.lp+1, (mSize-1)*sizeof(long));
         break;
     case TYPE_FLOAT:
         r = mData.fp[0];
-        memmove(mData.fp, mData.fp+1, (mSize-1)*sizeof(float));
         break;
     case TYPE_DOUBLE:
         r = mData.dp[0];
-        memmove(mData.dp, mData.dp+1, (mSize-1)*sizeof(double));
         break;
     case TYPE_CFLOAT:
         r = mData.cfp[0];
-        memmove(mData.cfp, mData.cfp+1, (mSize-1)*sizeof(cfloat));
         break;
     case TYPE_CDOUBLE:
         r = mData.cdp[0];
-        memmove(mData.cdp, mData.cdp+1, (mSize-1)*sizeof(cdouble));
         break;
     case TYPE_VAR:
         r = mData.vp[0];
         mData.vp[0].~var();
-        memmove(mData.vp, mData.vp+1, (mSize-1)*sizeof(var));
-        new (&mData.vp[mSize-1]) var();
+        new (&mData.vp[0]) var();
         break;
     case TYPE_PAIR:
         r = mData.pp[0].val;
         mData.pp[0].~pair();
-        memmove(mData.pp, mData.pp+1, (mSize-1)*sizeof(pair));
-        new (&mData.pp[mSize-1]) pair();
+        new (&mData.pp[0]) pair();
         break;
     default:
         throw error("Heap::shift(): Unknown type");
     }
-    resize(mSize-1);
+    mData.cp += sizeOf(mType);
+    mHead++;
+    mSize--;
+
+    // Once empty, the array can start again at the front
+    if (mSize == 0)
+    {
+        mData = base();
+        mHead = 0;
+        resize(0);
+    }
 
     // Done
     return r;
@@ -530,49 +539,136 @@ var Heap::shift()
 
 
 /**
- * Shift the array contents up (forwards).
+ * Shift the array contents up (forwards).  The start of the array moves down
+ * into the space at the front; if there is none, the array is moved to leave
+ * about as much space at the front as it occupies.
  */
 void Heap::unshift(var iVar)
 {
-    resize(mSize+1);
+    if (mType == TYPE_PAIR)
+        throw error("Heap::unshift(): Can't unshift a pair");
+    if (mHead == 0)
+    {
+        int need = (mType == TYPE_CHAR) ? mSize + 2 : mSize + 1;
+        int cap = allocSize(need*2);
+        relocate(cap, (cap - need + 1) / 2);
+    }
+    mData.cp -= sizeOf(mType);
+    mHead--;
+    mSize++;
     switch (mType)
     {
     case TYPE_CHAR:
-        memmove(mData.cp+1, mData.cp, (mSize-1)*sizeof(char));
         mData.cp[0] = iVar.get<char>();
         break;
     case TYPE_INT:
-        memmove(mData.ip+1, mData.ip, (mSize-1)*sizeof(int));
         mData.ip[0] = iVar.get<int>();
         break;
     case TYPE_LONG:
-        memmove(mData.lp+1, mData.lp, (mSize-1)*sizeof(long));
         mData.lp[0] = iVar.get<long>();
         break;
     case TYPE_FLOAT:
-        memmove(mData.fp+1, mData.fp, (mSize-1)*sizeof(float));
         mData.fp[0] = iVar.get<float>();
         break;
     case TYPE_DOUBLE:
-        memmove(mData.dp+1, mData.dp, (mSize-1)*sizeof(double));
         mData.dp[0] = iVar.get<double>();
         break;
     case TYPE_CFLOAT:
-        memmove(mData.cfp+1, mData.cfp, (mSize-1)*sizeof(cfloat));
         mData.cfp[0] = iVar.get<cfloat>();
         break;
     case TYPE_CDOUBLE:
-        memmove(mData.cdp+1, mData.cdp, (mSize-1)*sizeof(cdouble));
         mData.cdp[0] = iVar.get<cdouble>();
         break;
     case TYPE_VAR:
-        memmove(mData.vp+1, mData.vp, (mSize-1)*sizeof(var));
-        new (&mData.vp[0]) var();
         mData.vp[0] = iVar;
         break;
-    case TYPE_PAIR:
-        throw error("Heap::unshift(): Can't unshift a pair");
     default:
         throw error("Heap::unshift(): Unknown type");
     }
 }
+
+
+/**
+ * Opens a gap of iSize default elements at iIndex, moving the elements above
+ * it up in one block.  As for shift(), vars and pairs are relocated raw: the
+ * default elements that the block lands on are destroyed first, and the
+ * gap, which then holds stale copies, is re-constructed without destroying
+ * them.
+ */
+void Heap::insert(int iIndex, int iSize)
+{
+    if ((iIndex < 0) || (iIndex > mSize) || (iSize < 0))
+        throw std::range_error("Heap::insert(): index out of range");
+    if (iSize == 0)
+        return;
+    int size = mSize;
+    resize(mSize+iSize);
+    int s = sizeOf(mType);
+    switch (mType)
+    {
+    case TYPE_VAR:
+        for (int i=size; i<mSize; i++)
+            mData.vp[i].~var();
+        break;
+    case TYPE_PAIR:
+        for (int i=size; i<mSize; i++)
+            mData.pp[i].~pair();
+        break;
+    }
+    memmove(
+        mData.cp + (iIndex+iSize)*s, mData.cp + iIndex*s, (size-iIndex)*s
+    );
+    switch (mType)
+    {
+    case TYPE_VAR:
+        for (int i=iIndex; i<iIndex+iSize; i++)
+            new (&mData.vp[i]) var();
+        break;
+    case TYPE_PAIR:
+        for (int i=iIndex; i<iIndex+iSize; i++)
+            new (&mData.pp[i]) pair();
+        break;
+    }
+}
+
+
+/**
+ * Removes the iSize elements at iIndex, moving the elements above them down
+ * in one block.  vars and pairs are destroyed, then relocated raw, and the
+ * vacated elements at the top re-constructed.
+ */
+void Heap::remove(int iIndex, int iSize)
+{
+    if ((iIndex < 0) || (iSize < 0) || (iIndex+iSize > mSize))
+        throw std::range_error("Heap::remove(): index out of range");
+    if (iSize == 0)
+        return;
+    int s = sizeOf(mType);
+    switch (mType)
+    {
+    case TYPE_VAR:
+        for (int i=iIndex; i<iIndex+iSize; i++)
+            mData.vp[i].~var();
+        break;
+    case TYPE_PAIR:
+        for (int i=iIndex; i<iIndex+iSize; i++)
+            mData.pp[i].~pair();
+        break;
+    }
+    memmove(
+        mData.cp + iIndex*s, mData.cp + (iIndex+iSize)*s,
+        (mSize-iIndex-iSize)*s
+    );
+    switch (mType)
+    {
+    case TYPE_VAR:
+        for (int i=mSize-iSize; i<mSize; i++)
+            new (&mData.vp[i]) var();
+        break;
+    case TYPE_PAIR:
+        for (int i=mSize-iSize; i<mSize; i++)
+            new (&mData.pp[i]) pair();
+        break;
+    }
+    resize(mSize-iSize);
+}
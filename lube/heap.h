@@ -15,13 +15,6 @@
 
 namespace libube
 {
-    /** Two vars */
-    struct pair
-    {
-        var key;
-        var val;
-    };
-
     class Heap;
 
     /**
@@ -63,12 +56,12 @@ namespace libube
         virtual void resize(int iSize) = 0;
         virtual var at(int iIndex, bool iKey=false) const = 0;
         virtual var& key(int iIndex) = 0;
-        virtual bool neq(IHeap* iHeap) = 0;
-        virtual bool lt(IHeap* iHeap) = 0;
         virtual Heap* view() const = 0;
         virtual bool copyable(IHeap* iHeap) = 0;
         virtual var shift() = 0;
         virtual void unshift(var iVar) = 0;
+        virtual void insert(int iIndex, int iSize) = 0;
+        virtual void remove(int iIndex, int iSize) = 0;
         virtual bool defined(ind iIndex) = 0;
         virtual var* deref(ind iIndex) = 0;
         virtual int derefSize(ind iIndex) = 0;
@@ -83,6 +76,11 @@ namespace libube
      *
      * It's just a reference counted array.  It would make sense to allocate
      * these from a pool, but for the moment they're done individually.
+     *
+     * The array need not start at the start of the allocation: shift() just
+     * steps the start forward, and unshift() steps it back into space left
+     * at the front, so the array can be used as a queue at either end in
+     * amortised constant time.  The data are always contiguous.
      */
     class Heap : public IHeap
     {
@@ -138,12 +136,12 @@ namespace libube
         virtual void resize(int iSize);
         virtual var at(int iIndex, bool iKey=false) const;
         virtual var& key(int iIndex);
-        virtual bool neq(IHeap* iHeap);
-        virtual bool lt(IHeap* iHeap);
         virtual Heap* view() const { return 0; };
         virtual bool copyable(IHeap* iHeap) { return false; };
         virtual var shift();
         virtual void unshift(var iVar);
+        virtual void insert(int iIndex, int iSize);
+        virtual void remove(int iIndex, int iSize);
         virtual var* deref(ind iIndex);
         virtual bool defined(ind iIndex);
         virtual int derefSize(ind iIndex);
@@ -168,18 +166,21 @@ namespace libube
         dataType mData; ///< Pointer to allocated data
         int mSize;      ///< The externally visible size
         ind mType;      ///< The data type
+        int mCapacity ; ///< The allocation size
+        int mHead;      ///< Elements of the allocation before the first
 
         void copy(const Heap* iHeap, int iSize);
+        dataType base() const;
+        virtual void dealloc(dataType iData);
 
     private:
         // Members
-        int mCapacity ; ///< The allocation size
         int mRefCount;  ///< Reference count
 
         // Methods
         template<class T> T* data() const;
         void alloc(int iSize);
-        void dealloc(dataType iData);
+        void relocate(int iCapacity, int iHead);
     };
 
 
@@ -224,6 +225,18 @@ namespace libube
         virtual int& shape(int iDim) const;
         virtual int& stride(int iDim) const;
         virtual bool copyable(IHeap* iHeap);
+        virtual var shift() {
+            throw error("View::shift(): can't resize a view");
+        };
+        virtual void unshift(var) {
+            throw error("View::unshift(): can't resize a view");
+        };
+        virtual void insert(int, int) {
+            throw error("View::insert(): can't resize a view");
+        };
+        virtual void remove(int, int) {
+            throw error("View::remove(): can't resize a view");
+        };
         virtual int derefSize(ind iIndex) {
             return mHeap->derefSize(iIndex + mData.ip[0]);
         };
@@ -238,6 +251,30 @@ namespace libube
         void setStrides(int iDim);
         Heap* mHeap;    ///< The real storage
     };
+
+
+    /**
+     * Memory mapped heap
+     *
+     * A Heap whose storage is a private mapping of a region of a file rather
+     * than an allocation.  Pages are read on demand and are shared with other
+     * processes mapping the same file.  Writing to the array causes the kernel
+     * to copy the affected pages (copy-on-write), so the file itself is never
+     * modified.  Growing the array beyond the mapping moves it to normal
+     * storage.
+     */
+    class Mmap : public Heap
+    {
+    public:
+        Mmap(var iFile, ind iType, long iOffset=0, int iSize=-1);
+        virtual ~Mmap();
+        virtual void resize(int iSize);
+    protected:
+        virtual void dealloc(dataType iData);
+    private:
+        void* mAddr;     ///< Page aligned start of the mapping
+        size_t mLength;  ///< Length of the mapping in bytes
+    };
 }
 
 #endif // HEAP_H
@@ -10,19 +10,29 @@
 #include <fstream>
 #include <stdexcept>
 #include <lube/module.h>
+#include <lube/lines.h>
 
 namespace libube
 {
+    /**
+     * INI file handler
+     *
+     * With an "intern" attribute, section names and keys are interned, so
+     * the result must stay in the reading thread.
+     */
     class inifile : public file
     {
     public:
+        inifile(var iAttr) { mAttr = iAttr; };
         virtual var read(var iFile);
         virtual void write(var iFile, var iVar);
+    private:
+        var mAttr;
     };
 
     void factory(Module** oModule, var iArg)
     {
-        *oModule = new inifile;
+        *oModule = new inifile(iArg);
     }
 }
 
@@ -32,14 +42,12 @@ using namespace libube;
 
 var inifile::read(var iFile)
 {
-    std::ifstream is(iFile.str(), std::ifstream::in);
-    if (is.fail())
-        throw error("inifile::read(): Open failed");
-
+    bool interning = mAttr && mAttr.at("intern");
+    lines ls(iFile);
     var oVar;
     var f;
     var section = "";
-    while (f.getline(is))
+    while (ls.getline(f))
     {
         f.strip();
         if (f.size() == 0 || f[0] == ';' || f[0] == '#')
@@ -54,6 +62,8 @@ var inifile::read(var iFile)
             section = f.copy();
             section.resize(close);
             section.shift();
+            if (interning)
+                section = intern(section);
         }
         else
         {
@@ -65,7 +75,7 @@ var inifile::read(var iFile)
                 throw error("inifile::read(): couldn't split");
             kv[0].strip();
             kv[1].strip();
-            oVar[section][kv[0]] = kv[1];
+            oVar[section][interning ? intern(kv[0]) : kv[0]] = kv[1];
         }
     }
     return oVar;
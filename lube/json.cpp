@@ -23,6 +23,7 @@ namespace libube
     class JSON
     {
     public:
+        JSON() { mIntern = false; };
         var operator ()(std::istream& iStream);
         void format(std::ostream& iStream, var iVar, int iIndent = 0);
     private:
@@ -34,6 +35,7 @@ namespace libube
         var doArray(std::istream& iStream);
         var doString(std::istream& iStream);
         var doRaw(std::istream& iStream);
+        bool mIntern; ///< Whether object keys are interned
     };
 }
 
@@ -91,6 +93,8 @@ var JSON::doObject(std::istream& iStream)
             break;
         case '"':
             key = doString(iStream);
+            if (mIntern)
+                key = intern(key);
             break;
         case ':':
             iStream.get();
@@ -215,6 +219,13 @@ var JSON::doRaw(std::istream& iStream)
     throw error(e);
 }
 
+/** The stream flag set by internkeys */
+static int internIndex()
+{
+    static int index = std::ios_base::xalloc();
+    return index;
+}
+
 /**
  * For proper JSON we should call doObject(), mandating it be in braces.  In
  * calling doValue() we're allowing just raw values which is OK for lube but
@@ -222,10 +233,22 @@ var JSON::doRaw(std::istream& iStream)
  */
 var JSON::operator()(std::istream& iStream)
 {
+    mIntern = iStream.iword(internIndex());
     var val = doValue(iStream);
     return val;
 }
 
+/**
+ * Manipulator to intern the keys of objects read from the stream, as in
+ * `is >> internkeys >> v`.  Documents with many objects of the same form
+ * then store each key once.
+ */
+std::istream& libube::internkeys(std::istream& iStream)
+{
+    iStream.iword(internIndex()) = 1;
+    return iStream;
+}
+
 std::istream& libube::operator >>(std::istream& iStream, var& ioVar)
 {
     JSON json;
@@ -0,0 +1,246 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lube/lines.h"
+
+using namespace libube;
+
+
+/**
+ * Constructor without a file; call open() to read one
+ */
+lines::lines(int iBlock)
+{
+    if (iBlock <= 0)
+        throw error("lines::lines(): Block size must be positive");
+    mFD = -1;
+    mOwn = false;
+    mEOF = true;
+    mCapacity = iBlock;
+    mBuf = new char[mCapacity];
+    mBeg = 0;
+    mEnd = 0;
+}
+
+
+lines::lines(var iFile, int iBlock) : lines(iBlock)
+{
+    open(iFile);
+}
+
+
+/**
+ * Takes over the descriptor and buffer of iLines, which is left closed.
+ */
+lines::lines(lines&& iLines)
+{
+    mFD = iLines.mFD;
+    mOwn = iLines.mOwn;
+    mEOF = iLines.mEOF;
+    mBuf = iLines.mBuf;
+    mCapacity = iLines.mCapacity;
+    mBeg = iLines.mBeg;
+    mEnd = iLines.mEnd;
+    iLines.mFD = -1;
+    iLines.mOwn = false;
+    iLines.mEOF = true;
+    iLines.mBuf = 0;
+    iLines.mCapacity = 0;
+    iLines.mBeg = 0;
+    iLines.mEnd = 0;
+}
+
+
+lines::lines(int iFD, int iBlock, bool iOwn) : lines(iBlock)
+{
+    mFD = iFD;
+    mOwn = iOwn;
+    mEOF = false;
+}
+
+
+/**
+ * Read from an already open file descriptor, e.g., 0 for stdin.  The
+ * descriptor is not closed.
+ */
+lines lines::descriptor(int iFD, int iBlock)
+{
+    return lines(iFD, iBlock, false);
+}
+
+
+lines::~lines()
+{
+    close();
+    delete [] mBuf;
+}
+
+
+void lines::open(var iFile)
+{
+    close();
+    mFD = ::open(iFile.str(), O_RDONLY);
+    if (mFD < 0)
+        throw error("lines::open(): Open failed");
+    mOwn = true;
+    mEOF = false;
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(mFD, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+
+void lines::close()
+{
+    if (mOwn && (mFD >= 0))
+        ::close(mFD);
+    mFD = -1;
+    mOwn = false;
+    mEOF = true;
+    mBeg = 0;
+    mEnd = 0;
+}
+
+
+/**
+ * Move the unread data to the front of the buffer and read more after it.  The
+ * buffer grows if a single line fills it.  Returns false if nothing more could
+ * be read.
+ */
+bool lines::fill()
+{
+    if (mEOF)
+        return false;
+    int left = mEnd - mBeg;
+    if (mBeg > 0)
+    {
+        std::memmove(mBuf, mBuf + mBeg, left);
+        mBeg = 0;
+        mEnd = left;
+    }
+    else if (mEnd == mCapacity)
+    {
+        char* buf = new char[mCapacity * 2];
+        std::memcpy(buf, mBuf, mEnd);
+        delete [] mBuf;
+        mBuf = buf;
+        mCapacity *= 2;
+    }
+    ssize_t n;
+    do
+        n = ::read(mFD, mBuf + mEnd, mCapacity - mEnd);
+    while ((n < 0) && (errno == EINTR));
+    if (n < 0)
+        throw error("lines::fill(): read failed");
+    if (n == 0)
+        mEOF = true;
+    mEnd += n;
+    return n > 0;
+}
+
+
+/**
+ * Find the next line.  On success, oLine points to the line in the internal
+ * buffer and oSize is its length; it is not null terminated.  Returns false at
+ * the end of the file.
+ */
+bool lines::next(const char*& oLine, int& oSize)
+{
+    int from = mBeg;
+    for (;;)
+    {
+        char* nl = (char*)std::memchr(mBuf + from, '\n', mEnd - from);
+        if (nl)
+        {
+            oLine = mBuf + mBeg;
+            oSize = nl - oLine;
+            mBeg += oSize + 1;
+            return true;
+        }
+
+        // No newline in the buffer; there's no need to search the same data
+        // again after the fill
+        from = mEnd - mBeg;
+        if (!fill())
+            break;
+    }
+
+    // The last line may have no newline
+    if (mEnd > mBeg)
+    {
+        oLine = mBuf + mBeg;
+        oSize = mEnd - mBeg;
+        mBeg = mEnd;
+        return true;
+    }
+    return false;
+}
+
+
+/**
+ * Read a line into a var.  As var::getline(), oLine is re-used as a string if
+ * it is one already, and is cleared at the end of the file.
+ */
+var& lines::getline(var& oLine)
+{
+    const char* line;
+    int size;
+    if (!next(line, size))
+        return oLine.clear();
+    if (!oLine.defined() || !oLine.atype<char>())
+        oLine = "";
+    oLine.resize(size);
+    std::memcpy(oLine.ptr<char>(), line, size);
+    return oLine;
+}
+
+
+mapped::mapped(var iFile)
+{
+    mAddr = 0;
+    mSize = 0;
+    int fd = ::open(iFile.str(), O_RDONLY);
+    if (fd < 0)
+        throw error("mapped::mapped(): Open failed");
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        ::close(fd);
+        throw error("mapped::mapped(): stat failed");
+    }
+    if (st.st_size > 0)
+    {
+        void* addr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            ::close(fd);
+            throw error("mapped::mapped(): mmap failed");
+        }
+        mAddr = addr;
+        mSize = st.st_size;
+#ifdef POSIX_MADV_SEQUENTIAL
+        posix_madvise(mAddr, mSize, POSIX_MADV_SEQUENTIAL);
+#endif
+    }
+    ::close(fd);
+}
+
+
+mapped::~mapped()
+{
+    if (mAddr)
+        munmap(mAddr, mSize);
+}
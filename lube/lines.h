@@ -0,0 +1,74 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#ifndef LINES_H
+#define LINES_H
+
+#include <lube/var.h>
+
+namespace libube
+{
+    /**
+     * Block buffered line reader
+     *
+     * Reads a file descriptor in large blocks and finds the line ends with
+     * memchr().  Lines are handed out either as slices of the internal buffer,
+     * valid until the next call, or copied into a var that is re-used.  The
+     * newline is not included.  Cf. var::getline(), which reads an istream a
+     * character at a time.  descriptor() reads an already open descriptor.
+     */
+    class lines
+    {
+    public:
+        lines(int iBlock=65536);
+        lines(var iFile, int iBlock=65536);
+        lines(const lines&) = delete;
+        lines(lines&& iLines);
+        lines& operator =(const lines&) = delete;
+        ~lines();
+        static lines descriptor(int iFD, int iBlock=65536);
+        void open(var iFile);
+        void close();
+        bool next(const char*& oLine, int& oSize);
+        var& getline(var& oLine);
+    private:
+        int mFD;        ///< The file descriptor
+        bool mOwn;      ///< Whether to close the descriptor
+        bool mEOF;      ///< Whether the descriptor is exhausted
+        char* mBuf;     ///< The buffer
+        int mCapacity;  ///< Size of the buffer
+        int mBeg;       ///< Start of unread data in the buffer
+        int mEnd;       ///< End of unread data in the buffer
+        lines(int iFD, int iBlock, bool iOwn);
+        bool fill();
+    };
+
+    /**
+     * Read only memory map of a whole file
+     *
+     * For parsers that want all the bytes at once.  Unlike mapfile(), there
+     * is no var, so the size isn't limited to an int and the data aren't
+     * terminated; an empty file has no data.
+     */
+    class mapped
+    {
+    public:
+        mapped(var iFile);
+        mapped(const mapped&) = delete;
+        mapped& operator =(const mapped&) = delete;
+        ~mapped();
+        const char* data() const { return (const char*)mAddr; };
+        size_t size() const { return mSize; };
+    private:
+        void* mAddr;   ///< The mapping, or 0
+        size_t mSize;  ///< Bytes in the mapping
+    };
+}
+
+#endif // LINES_H
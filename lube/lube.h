@@ -12,10 +12,16 @@
 #include <lube/var.h>
 #include <lube/regex.h>
 #include <lube/module.h>
+#include <lube/lines.h>
+#include <lube/batch.h>
+#include <lube/hash.h>
 
 namespace lube = libube;
 typedef lube::ind ind;
 typedef lube::var var;
 typedef lube::varstream varstream;
+typedef lube::strbuilder strbuilder;
+typedef lube::varset varset;
+typedef lube::varmap varmap;
 
 #endif // LUBE_H
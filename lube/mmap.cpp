@@ -0,0 +1,162 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#include <cassert>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lube/var.h"
+#include "lube/heap.h"
+
+using namespace libube;
+
+// In heap.cpp
+int sizeOf(ind iType);
+
+
+/**
+ * Map iSize elements of type iType starting at byte iOffset of iFile.  A
+ * negative size means up to the end of the file.
+ *
+ * mmap() wants a page aligned offset, so the mapping starts at the page
+ * boundary below iOffset and the data pointer is advanced to the region.
+ */
+Mmap::Mmap(var iFile, ind iType, long iOffset, int iSize) : Heap()
+{
+    mAddr = 0;
+    mLength = 0;
+    mType = iType;
+    if ((mType == TYPE_ARRAY) || (mType == TYPE_VAR) || (mType == TYPE_PAIR))
+        throw error("Mmap::Mmap(): can only map basic types");
+
+    int fd = open(iFile.str(), O_RDONLY);
+    if (fd < 0)
+        throw error("Mmap::Mmap(): Open failed");
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        throw error("Mmap::Mmap(): stat failed");
+    }
+
+    // Find the region
+    long elem = sizeOf(mType);
+    long end = st.st_size;
+    long size = (iSize < 0) ? (end - iOffset) / elem : iSize;
+    if ((iOffset < 0) || (iOffset + size*elem > end))
+    {
+        close(fd);
+        throw error("Mmap::Mmap(): region beyond end of file");
+    }
+    if (size > INT_MAX)
+    {
+        close(fd);
+        throw error("Mmap::Mmap(): region has too many elements");
+    }
+    iSize = size;
+
+    // An empty region is just an empty heap
+    if (iSize == 0)
+    {
+        close(fd);
+        Heap::resize(0);
+        return;
+    }
+
+    // Strings need a terminator.  Mapping one byte past the region is fine
+    // unless the region ends the file exactly on a page boundary, in which
+    // case the byte does not exist; then the string is copied to the heap.
+    long page = sysconf(_SC_PAGESIZE);
+    long base = iOffset / page * page;
+    long last = iOffset + iSize*elem;
+    bool room = (last < end) || (last % page);
+    mLength = last - base;
+    if ((mType == TYPE_CHAR) && room)
+        mLength += 1;
+
+    // The private mapping gives copy-on-write semantics
+    mAddr = mmap(0, mLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, base);
+    close(fd);
+    if (mAddr == MAP_FAILED)
+    {
+        mAddr = 0;
+        throw error("Mmap::Mmap(): mmap failed");
+    }
+    mData.cp = (char*)mAddr + (iOffset - base);
+    mSize = iSize;
+    mCapacity = (mLength - (iOffset - base)) / elem;
+    if (mType == TYPE_CHAR)
+    {
+        if (room)
+            mData.cp[mSize] = 0;
+        else
+            // No room for the terminator; moves it off the mapping
+            Heap::resize(mSize);
+    }
+}
+
+
+Mmap::~Mmap()
+{
+    if (mAddr)
+        munmap(mAddr, mLength);
+}
+
+
+/**
+ * Shrinking, or growing within the mapping, just moves the end.  Anything else
+ * goes to the base class, which will move the data to an allocation and call
+ * dealloc() on the mapping.
+ */
+void Mmap::resize(int iSize)
+{
+    int need = (mType == TYPE_CHAR) ? iSize + 1 : iSize;
+    if (!mAddr || (mHead + need > mCapacity))
+    {
+        Heap::resize(iSize);
+        return;
+    }
+    mSize = iSize;
+    if (mType == TYPE_CHAR)
+        mData.cp[mSize] = 0;
+}
+
+
+/**
+ * Called by the base class both on the final detach and when the array is
+ * re-allocated.  The mapping is released rather than deleted.
+ */
+void Mmap::dealloc(dataType iData)
+{
+    if (mAddr && (iData.cp >= (char*)mAddr) &&
+        (iData.cp < (char*)mAddr + mLength))
+    {
+        munmap(mAddr, mLength);
+        mAddr = 0;
+        return;
+    }
+    Heap::dealloc(iData);
+}
+
+
+/**
+ * Map a file, or a region of it, as an array.  The element type is that of
+ * iType, defaulting to float as for view().  iOffset is in bytes and iSize in
+ * elements; a negative size means up to the end of the file.
+ */
+var libube::mapfile(var iFile, var iType, long iOffset, int iSize)
+{
+    var t = iType ? iType : 0.0f;
+    var r;
+    r.attach(new Mmap(iFile, t.atype(), iOffset, iSize));
+    return r;
+}
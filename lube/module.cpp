@@ -8,43 +8,119 @@
  */
 
 #include <cassert>
+#include <map>
+#include <mutex>
 #include <stdexcept>
+#include <string>
 #include <dlfcn.h>
 
 #include "lube/module.h"
 
 
+/**
+ * Registry entry for a dynamic library, or for a module built into this one
+ */
+struct libube::library
+{
+    void* handle;  ///< Handle for dynamic library, null if built in
+    void (*factory)(Module** oModule, var iArg);
+    int count;     ///< Loaders and instances using the library
+};
+
+
 using namespace libube;
 
 
-module::module(var iType)
+#ifdef HAVE_STATIC_MODULES
+/** The table of modules built into the library; see staticmodules.cpp.in */
+namespace libube
 {
-    // Initialise
-    mHandle = 0;
-    char *dle = dlerror();
+    struct staticmodule
+    {
+        const char* type;
+        void (*factory)(Module** oModule, var iArg);
+    };
+    extern const staticmodule gStaticModules[];
+}
+#endif
+
+
+/*
+ * The registry of libraries.  The entries are never moved by the map, so
+ * loaders can keep pointers to them.
+ */
+static std::mutex sMutex;
+static std::map<std::string, library>& registry()
+{
+    static std::map<std::string, library> sRegistry;
+    return sRegistry;
+}
+
+
+/**
+ * Finds the library for iType, loading it if necessary.  Must be called with
+ * the registry locked.
+ */
+static library& load(var iType)
+{
+    std::string type = iType.str();
+    std::map<std::string, library>::iterator it = registry().find(type);
+    if (it != registry().end())
+        return it->second;
+
+#ifdef HAVE_STATIC_MODULES
+    // A built-in module has a null handle
+    for (const staticmodule* m = gStaticModules; m->type; m++)
+        if (type == m->type)
+        {
+            library l;
+            l.handle = 0;
+            l.factory = m->factory;
+            l.count = 0;
+            return registry()[type] = l;
+        }
+#endif
 
     // Open the library
+    char *dle = dlerror();
     varstream lib;
-    lib << "lib" << iType.str() << ".so";
-    mHandle = dlopen(lib.str(), RTLD_LAZY);
+    lib << "lib" << type << ".so";
+    void* handle = dlopen(lib.str(), RTLD_LAZY);
     if ((dle = dlerror()) != NULL)
         throw error(dle);
-    if (!mHandle)
+    if (!handle)
         throw error("module::module(): dlopen failed");
 
     // Find the factory function
-    *(void **)(&mFactory) = dlsym(mHandle, "factory");
+    library l;
+    l.handle = handle;
+    l.count = 0;
+    *(void **)(&l.factory) = dlsym(handle, "factory");
     if ((dle = dlerror()) != NULL)
+    {
+        dlclose(handle);
         throw error(dle);
+    }
+    return registry()[type] = l;
+}
+
+
+module::module(var iType)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    mLibrary = &load(iType);
+    mFactory = mLibrary->factory;
+    mLibrary->count++;
 }
 
 
 module::~module()
 {
-    // Delete the instances before closing the dynamic library
+    // Delete the instances; the library itself stays loaded
     for (size_t i=0; i<mInstance.size(); i++)
         delete mInstance[i];
-    dlclose(mHandle);
+    std::lock_guard<std::mutex> lock(sMutex);
+    mLibrary->count -= mInstance.size() + 1;
 }
 
 
@@ -61,5 +137,43 @@ Module& module::create(var iArg)
     if (!inst)
         throw error("Module factory failed");
     mInstance.push_back(inst);
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        mLibrary->count++;
+    }
     return *(mInstance.back());
 }
+
+
+/**
+ * Loads the library of each of iTypes, a string or array of strings, so that
+ * later loaders find it in the registry.
+ */
+void module::preload(var iTypes)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    if (iTypes.atype<char>())
+        load(iTypes);
+    else
+        for (int i=0; i<iTypes.size(); i++)
+            load(iTypes.at(i));
+}
+
+
+/**
+ * Closes the library for iType if nothing is using it.  Returns true if the
+ * library is not loaded on return.
+ */
+bool module::unload(var iType)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    std::map<std::string, library>::iterator it = registry().find(iType.str());
+    if (it == registry().end())
+        return true;
+    if (it->second.count > 0)
+        return false;
+    if (it->second.handle)
+        dlclose(it->second.handle);
+    registry().erase(it);
+    return true;
+}
@@ -35,11 +35,19 @@ namespace libube
     }
 
 
+    struct library;
+
     /**
      * Module factory
      *
      * This is actually a loader for the module rather than the module itself.
      * The create() method is a factory method that generates modules.
+     *
+     * The libraries are held in a process-wide registry, so each is loaded
+     * and its factory found just once however many loaders there are.  The
+     * registry counts the loaders and instances using each library; a library
+     * stays loaded until unload() is called when the count is zero.
+     * preload() loads libraries ahead of time.
      */
     class module
     {
@@ -47,11 +55,13 @@ namespace libube
         module(var iType);
         virtual ~module();
         virtual Module& create(var iArg=nil);
+        static void preload(var iTypes);
+        static bool unload(var iType);
     protected:
         std::vector<Module*> mInstance; ///< Instances of module
     private:
         void (*mFactory)(Module** oModule, var iArg);
-        void* mHandle;     ///< Handle for dynamic library
+        library* mLibrary;  ///< Registry entry for dynamic library
     };
 
 
@@ -0,0 +1,500 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#include <cctype>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <lube/module.h>
+
+#include <zlib.h>
+
+namespace libube
+{
+    /**
+     * NumPy file handler
+     *
+     * Reads and writes the .npy format, and .npz archives of .npy files.  The
+     * data go straight between the file and a dense array; arrays of more than
+     * one dimension are returned as views.  Only little endian, C order data
+     * are handled.
+     *
+     * The attribute var passed at creation may contain "mmap", in which case
+     * uncompressed arrays are memory mapped rather than read.
+     */
+    class NPYFile : public file
+    {
+    public:
+        NPYFile(var iAttr) { mAttr = iAttr; };
+        virtual var read(var iFile);
+        virtual void write(var iFile, var iVar);
+    private:
+        var mAttr;
+        var readNPY(std::istream& iIS, var iFile=nil, long iOffset=0);
+        var readNPZ(std::istream& iIS, var iFile);
+        var header(var iVar);
+        long bytes(var iVar);
+        const char* data(var iVar);
+        void writeNPY(std::ostream& iOS, var iVar);
+        void writeNPZ(std::ostream& iOS, var iVar);
+    };
+
+    void factory(Module** oModule, var iArg)
+    {
+        *oModule = new NPYFile(iArg);
+    }
+}
+
+
+using namespace libube;
+
+
+/**
+ * A read-only stream buffer over a block of memory; lets the .npy parser read
+ * decompressed .npz members without copying them again.
+ */
+class membuf : public std::streambuf
+{
+public:
+    membuf(char* iData, size_t iSize) { setg(iData, iData, iData + iSize); };
+};
+
+
+/*
+ * Little endian integers as found in the zip format
+ */
+static uint32_t le(const unsigned char* iP, int iBytes)
+{
+    uint32_t r = 0;
+    for (int i=iBytes-1; i>=0; i--)
+        r = (r << 8) | iP[i];
+    return r;
+}
+
+static void le(std::ostream& iOS, uint32_t iVal, int iBytes)
+{
+    for (int i=0; i<iBytes; i++)
+    {
+        iOS.put((char)(iVal & 0xff));
+        iVal >>= 8;
+    }
+}
+
+
+/**
+ * Map a numpy type descriptor such as '<f4' to an exemplar var of that type
+ */
+static var exemplar(const char* iDescr)
+{
+    if (iDescr[0] == '>')
+        throw error("NPYFile: big endian data not supported");
+    const char* d = iDescr + 1;
+    if (!std::strcmp(d, "f4"))
+        return 0.0f;
+    if (!std::strcmp(d, "f8"))
+        return 0.0;
+    if (!std::strcmp(d, "c8"))
+        return cfloat(0.0f);
+    if (!std::strcmp(d, "c16"))
+        return cdouble(0.0);
+    if (!std::strcmp(d, "i4"))
+        return 0;
+    if (!std::strcmp(d, "i8") && (sizeof(long) == 8))
+        return 0l;
+    varstream s;
+    s << "NPYFile: unsupported type " << iDescr;
+    throw error(s);
+}
+
+
+/**
+ * Read one array in .npy format from a stream.  If iFile is given then
+ * iOffset is the position of the stream in that file, and the data may be
+ * mapped rather than read.
+ */
+var NPYFile::readNPY(std::istream& iIS, var iFile, long iOffset)
+{
+    // Magic string, version and header length
+    unsigned char pre[12];
+    if (!iIS.read((char*)pre, 8) || std::memcmp(pre, "\x93NUMPY", 6))
+        throw error("NPYFile::readNPY(): not a .npy file");
+    int lenBytes = (pre[6] == 1) ? 2 : 4;
+    if (!iIS.read((char*)pre+8, lenBytes))
+        throw error("NPYFile::readNPY(): short header");
+    int len = le(pre+8, lenBytes);
+    var dict = "";
+    dict.resize(len);
+    if (!iIS.read(dict.ptr<char>(), len))
+        throw error("NPYFile::readNPY(): short header");
+
+    // The header is a python dict literal; the keys are fixed so it's enough
+    // to look for them
+    const char* h = dict.str();
+    const char* p = std::strstr(h, "'descr':");
+    if (!p)
+        throw error("NPYFile::readNPY(): no descr");
+    p = std::strchr(p+8, '\'');
+    const char* q = p ? std::strchr(p+1, '\'') : 0;
+    if (!q)
+        throw error("NPYFile::readNPY(): bad descr");
+    var type = exemplar(var(q-p-1, p+1).str());
+    p = std::strstr(h, "'fortran_order':");
+    if (p)
+    {
+        p += 16;
+        while (std::isspace((unsigned char)*p))
+            p++;
+        if (!std::strncmp(p, "True", 4))
+            throw error("NPYFile::readNPY(): Fortran order not supported");
+    }
+    p = std::strstr(h, "'shape':");
+    p = p ? std::strchr(p, '(') : 0;
+    q = p ? std::strchr(p, ')') : 0;
+    if (!q)
+        throw error("NPYFile::readNPY(): bad shape");
+    var dims = var(q-p-1, p+1).split(",");
+    var shape;
+    int size = 1;
+    for (int i=0; i<dims.size(); i++)
+        if (dims[i].strip().size() > 0)
+        {
+            shape.push(dims[i].cast<int>());
+            size *= shape.top().get<int>();
+        }
+
+    // The data; either map it or read it
+    var r;
+    long offset = iOffset + 8 + lenBytes + len;
+    if (iFile && mAttr && mAttr.at("mmap"))
+        r = mapfile(iFile, type, offset, size);
+    else
+    {
+        r = type;
+        r.array();
+        r.resize(size);
+        if (!iIS.read(r.ptr<char>(), bytes(r)))
+            throw error("NPYFile::readNPY(): short data");
+    }
+    if (shape.size() == 0)
+        // A numpy scalar
+        return r.at(0).dereference();
+    if (shape.size() > 1)
+        r = r.view(shape);
+    return r;
+}
+
+
+/**
+ * Read the arrays of a .npz (zip) archive into a map keyed on the array names.
+ * The directory at the end of the archive gives the members; stored members
+ * are read (or mapped) in place, deflated ones are inflated into memory first.
+ */
+var NPYFile::readNPZ(std::istream& iIS, var iFile)
+{
+    // Find the end of central directory record; it's at the end unless there
+    // is a comment
+    iIS.seekg(0, std::ios::end);
+    long end = iIS.tellg();
+    long tail = std::min(end, 22L + 65535L);
+    std::vector<unsigned char> buf(tail);
+    iIS.seekg(end - tail);
+    iIS.read((char*)buf.data(), tail);
+    long eocd = -1;
+    for (long i=tail-22; i>=0; i--)
+        if (le(&buf[i], 4) == 0x06054b50)
+        {
+            eocd = i;
+            break;
+        }
+    if (eocd < 0)
+        throw error("NPYFile::readNPZ(): no zip directory");
+    int nEntries = le(&buf[eocd+10], 2);
+    long dirSize = le(&buf[eocd+12], 4);
+    long dirOffset = le(&buf[eocd+16], 4);
+
+    // Read the central directory
+    std::vector<unsigned char> dir(dirSize);
+    iIS.seekg(dirOffset);
+    if (!iIS.read((char*)dir.data(), dirSize))
+        throw error("NPYFile::readNPZ(): short zip directory");
+
+    var r;
+    r[nil];
+    const unsigned char* p = dir.data();
+    for (int e=0; e<nEntries; e++)
+    {
+        if (le(p, 4) != 0x02014b50)
+            throw error("NPYFile::readNPZ(): bad zip directory");
+        int method = le(p+10, 2);
+        uint64_t cSize = le(p+20, 4);
+        uint64_t uSize = le(p+24, 4);
+        int nameLen = le(p+28, 2);
+        int extraLen = le(p+30, 2);
+        int commentLen = le(p+32, 2);
+        uint64_t local = le(p+42, 4);
+        var name(nameLen, (const char*)p+46);
+
+        // zip64 sizes and offset are in an extra field, in order, but only
+        // those that overflowed
+        const unsigned char* x = p + 46 + nameLen;
+        while (x < p + 46 + nameLen + extraLen)
+        {
+            int id = le(x, 2);
+            int len = le(x+2, 2);
+            if (id == 0x0001)
+            {
+                const unsigned char* v = x + 4;
+                if (uSize == 0xffffffff)
+                    { uSize = le(v, 4) | (uint64_t)le(v+4, 4) << 32; v += 8; }
+                if (cSize == 0xffffffff)
+                    { cSize = le(v, 4) | (uint64_t)le(v+4, 4) << 32; v += 8; }
+                if (local == 0xffffffff)
+                    local = le(v, 4) | (uint64_t)le(v+4, 4) << 32;
+            }
+            x += 4 + len;
+        }
+        p += 46 + nameLen + extraLen + commentLen;
+
+        // The local header has its own name and extra lengths
+        unsigned char lh[30];
+        iIS.seekg(local);
+        if (!iIS.read((char*)lh, 30) || (le(lh, 4) != 0x04034b50))
+            throw error("NPYFile::readNPZ(): bad local header");
+        long data = local + 30 + le(lh+26, 2) + le(lh+28, 2);
+
+        // numpy names the members <key>.npy
+        if ((name.size() > 4) && !std::strcmp(name.str()+name.size()-4, ".npy"))
+            name.resize(name.size()-4);
+        switch (method)
+        {
+        case 0:
+            iIS.seekg(data);
+            r[name] = readNPY(iIS, iFile, data);
+            break;
+        case 8:
+        {
+            std::vector<char> in(cSize);
+            std::vector<char> out(uSize);
+            iIS.seekg(data);
+            if (!iIS.read(in.data(), cSize))
+                throw error("NPYFile::readNPZ(): short member");
+            z_stream z;
+            std::memset(&z, 0, sizeof(z));
+            if (inflateInit2(&z, -MAX_WBITS) != Z_OK)
+                throw error("NPYFile::readNPZ(): inflateInit failed");
+            z.next_in = (Bytef*)in.data();
+            z.avail_in = cSize;
+            z.next_out = (Bytef*)out.data();
+            z.avail_out = uSize;
+            int ret = inflate(&z, Z_FINISH);
+            inflateEnd(&z);
+            if (ret != Z_STREAM_END)
+                throw error("NPYFile::readNPZ(): inflate failed");
+            membuf mb(out.data(), uSize);
+            std::istream is(&mb);
+            r[name] = readNPY(is);
+            break;
+        }
+        default:
+            throw error("NPYFile::readNPZ(): unknown compression");
+        }
+    }
+    return r;
+}
+
+
+var NPYFile::read(var iFile)
+{
+    std::ifstream is(iFile.str(), std::ifstream::in | std::ifstream::binary);
+    if (is.fail())
+        throw error("NPYFile::read(): Open failed");
+
+    // A zip archive starts with a local header
+    char magic[2];
+    if (!is.read(magic, 2))
+        throw error("NPYFile::read(): Empty file");
+    is.seekg(0);
+    if ((magic[0] == 'P') && (magic[1] == 'K'))
+        return readNPZ(is, iFile);
+    return readNPY(is, iFile, 0);
+}
+
+
+/**
+ * The number of bytes in the (dense) array
+ */
+long NPYFile::bytes(var iVar)
+{
+    long elem;
+    switch (iVar.atype())
+    {
+    case TYPE_FLOAT: elem = sizeof(float); break;
+    case TYPE_DOUBLE: elem = sizeof(double); break;
+    case TYPE_CFLOAT: elem = sizeof(cfloat); break;
+    case TYPE_CDOUBLE: elem = sizeof(cdouble); break;
+    case TYPE_INT: elem = sizeof(int); break;
+    case TYPE_LONG: elem = sizeof(long); break;
+    default:
+        throw error("NPYFile: unsupported type");
+    }
+    return elem * iVar.size();
+}
+
+
+/**
+ * Pointer to the data.  The typed ptr<>() respects view offsets.
+ */
+const char* NPYFile::data(var iVar)
+{
+    switch (iVar.atype())
+    {
+    case TYPE_FLOAT: return (const char*)iVar.ptr<float>();
+    case TYPE_DOUBLE: return (const char*)iVar.ptr<double>();
+    case TYPE_CFLOAT: return (const char*)iVar.ptr<cfloat>();
+    case TYPE_CDOUBLE: return (const char*)iVar.ptr<cdouble>();
+    case TYPE_INT: return (const char*)iVar.ptr<int>();
+    case TYPE_LONG: return (const char*)iVar.ptr<long>();
+    default:
+        throw error("NPYFile: unsupported type");
+    }
+}
+
+
+/**
+ * The .npy preamble and header for an array, padded such that the data are
+ * aligned to 64 bytes.
+ */
+var NPYFile::header(var iVar)
+{
+    const char* descr;
+    switch (iVar.atype())
+    {
+    case TYPE_FLOAT: descr = "<f4"; break;
+    case TYPE_DOUBLE: descr = "<f8"; break;
+    case TYPE_CFLOAT: descr = "<c8"; break;
+    case TYPE_CDOUBLE: descr = "<c16"; break;
+    case TYPE_INT: descr = "<i4"; break;
+    case TYPE_LONG: descr = "<i8"; break;
+    default:
+        throw error("NPYFile: unsupported type");
+    }
+    varstream dict;
+    dict << "{'descr': '" << descr << "', 'fortran_order': False, 'shape': (";
+    if (iVar.heap())
+        for (int i=0; i<iVar.dim(); i++)
+            dict << (i ? ", " : "") << iVar.shape(i);
+    dict << (iVar.heap() && (iVar.dim() == 1) ? ",), }" : "), }");
+    var d = dict;
+    int pad = 63 - (10 + d.size()) % 64;
+    d.resize(d.size() + pad + 1);
+    std::memset(d.ptr<char>(d.size()-pad-1), ' ', pad);
+    *d.ptr<char>(d.size()-1) = '\n';
+    if (d.size() > 0xffff)
+        throw error("NPYFile::header(): too many dimensions");
+
+    var h = "\x93NUMPY";
+    h.push('\x01');
+    h.push('\x00');
+    h.push((char)(d.size() & 0xff));
+    h.push((char)(d.size() >> 8));
+    h.append(d);
+    return h;
+}
+
+
+void NPYFile::writeNPY(std::ostream& iOS, var iVar)
+{
+    var h = header(iVar);
+    iOS.write(h.str(), h.size());
+    iOS.write(data(iVar), bytes(iVar));
+}
+
+
+/**
+ * Write a map of arrays as an uncompressed .npz (zip) archive.  Stored members
+ * mean the archive can in turn be mapped when read.
+ */
+void NPYFile::writeNPZ(std::ostream& iOS, var iVar)
+{
+    var dir = "";
+    long offset = 0;
+    for (int i=0; i<iVar.size(); i++)
+    {
+        var name = iVar.key(i).copy();
+        name.append(".npy");
+        var h = header(iVar[i]);
+        long size = h.size() + bytes(iVar[i]);
+        if (offset + size > 0xfffffffeL)
+            throw error("NPYFile::writeNPZ(): archive too large");
+        uLong crc = crc32(0L, Z_NULL, 0);
+        crc = crc32(crc, (const Bytef*)h.str(), h.size());
+        crc = crc32(crc, (const Bytef*)data(iVar[i]), bytes(iVar[i]));
+
+        // Local header
+        le(iOS, 0x04034b50, 4);
+        le(iOS, 20, 2);         // Version needed
+        le(iOS, 0, 2);          // Flags
+        le(iOS, 0, 2);          // Stored
+        le(iOS, 0, 4);          // Time and date
+        le(iOS, crc, 4);
+        le(iOS, size, 4);
+        le(iOS, size, 4);
+        le(iOS, name.size(), 2);
+        le(iOS, 0, 2);          // Extra length
+        iOS.write(name.str(), name.size());
+        writeNPY(iOS, iVar[i]);
+
+        // Central directory entry
+        varstream ds(dir);
+        le(ds, 0x02014b50, 4);
+        le(ds, 20, 2);          // Version made by
+        le(ds, 20, 2);          // Version needed
+        le(ds, 0, 2);
+        le(ds, 0, 2);
+        le(ds, 0, 4);
+        le(ds, crc, 4);
+        le(ds, size, 4);
+        le(ds, size, 4);
+        le(ds, name.size(), 2);
+        le(ds, 0, 2);           // Extra length
+        le(ds, 0, 2);           // Comment length
+        le(ds, 0, 2);           // Disk
+        le(ds, 0, 2);           // Internal attributes
+        le(ds, 0, 4);           // External attributes
+        le(ds, offset, 4);
+        ds << name.str();
+        offset += 30 + name.size() + size;
+    }
+    iOS.write(dir.str(), dir.size());
+
+    // End of central directory
+    le(iOS, 0x06054b50, 4);
+    le(iOS, 0, 2);
+    le(iOS, 0, 2);
+    le(iOS, iVar.size(), 2);
+    le(iOS, iVar.size(), 2);
+    le(iOS, dir.size(), 4);
+    le(iOS, offset, 4);
+    le(iOS, 0, 2);
+}
+
+
+void NPYFile::write(var iFile, var iVar)
+{
+    std::ofstream os(iFile.str(), std::ofstream::out | std::ofstream::binary);
+    if (os.fail())
+        throw error("NPYFile::write(): Open failed");
+    if (iVar.heap() && (iVar.atype() == TYPE_PAIR))
+        writeNPZ(os, iVar);
+    else
+        writeNPY(os, iVar);
+    if (os.fail())
+        throw error("NPYFile::write(): Write failed");
+}
@@ -14,7 +14,23 @@
  */
 
 #include "lube/path.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fnmatch.h>
 
 namespace fs = std::filesystem;
 
@@ -27,6 +43,7 @@ namespace libube
         Path(var iArg);
         var dir(bool iVal);
         var rdir(bool iVal);
+        var find(var iAttr, bool iVal);
         var tree();
     private:
         fs::path mPath;
@@ -42,68 +59,612 @@ namespace libube
 
 using namespace libube;
 
+
+/**
+ * Parallel directory walker
+ *
+ * Each worker has its own queue of directories.  It takes from the back of
+ * its own queue, so it tends to finish a subtree before starting another, and
+ * when that's empty it steals from the front of another worker's, which is
+ * where the larger subtrees are.  The entries are collected per worker and
+ * only merged at the end.  The attributes are converted to strings up front,
+ * so no var is shared between threads.
+ *
+ * With an index file, the listing of each directory is also recorded, along
+ * with its modification time and the size and modification time of each
+ * entry, and written to the index at the end.  On the next walk, a
+ * directory whose modification time hasn't changed is taken from the index
+ * rather than read.  Its subdirectories are still visited, as changes in
+ * them don't show in the parent.  The sizes and times of files are as they
+ * were when their directory was last read; only the names are guaranteed to
+ * be current.
+ */
+class walker
+{
+public:
+    walker(var iAttr);
+    std::vector<std::string> walk(const fs::path& iRoot);
+private:
+    struct queue
+    {
+        std::mutex mutex;
+        std::deque<std::string> dirs;
+    };
+    struct entry
+    {
+        std::string name;
+        int64_t size;
+        int64_t mtime;
+        bool dir;
+    };
+    struct record
+    {
+        int64_t mtime;   ///< Of the directory itself; -1 to always read it
+        std::vector<entry> entries;
+    };
+    typedef std::vector< std::pair<std::string, record> > records;
+    int mThreads;
+    std::vector<std::string> mGlob;
+    std::vector<std::string> mExt;
+    std::string mIndex;
+    std::unordered_map<std::string, record> mCache;
+    std::vector<records> mRecord;   ///< Per worker, for the new index
+    std::vector<record> mScratch;   ///< Per worker, when there's no index
+    int64_t mRecent;                ///< Times later than this are too recent
+    std::deque<queue> mQueue;
+    std::atomic<long> mPending;   ///< Directories queued or being read
+    std::atomic<bool> mStop;
+    std::mutex mIdleMutex;
+    std::condition_variable mIdle;  ///< Idle workers wait on this
+    long mGeneration;               ///< Bumped when there may be news
+    std::mutex mErrorMutex;
+    std::exception_ptr mError;
+    bool match(const std::string& iPath) const;
+    void give(int iWorker, std::string iDir);
+    void wake(bool iAll);
+    bool take(int iWorker, std::string& oDir);
+    const record& list(int iWorker, const std::string& iDir);
+    void work(int iWorker, std::vector<std::string>& oFound);
+    void load();
+    void save();
+};
+
+
+/** Appends iVar, a string or an array of strings, to oList */
+static void strings(var iVar, std::vector<std::string>& oList)
+{
+    if (!iVar)
+        return;
+    if (iVar.atype<char>())
+        oList.push_back(iVar.str());
+    else
+        for (int i=0; i<iVar.size(); i++)
+            oList.push_back(iVar.at(i).str());
+}
+
+
+walker::walker(var iAttr)
+{
+    mThreads = (iAttr && iAttr.at("threads"))
+        ? iAttr.at("threads").cast<int>() : 0;
+    if (mThreads <= 0)
+        mThreads = std::max(1u, std::thread::hardware_concurrency());
+    if (iAttr)
+    {
+        strings(iAttr.at("glob"), mGlob);
+        strings(iAttr.at("ext"), mExt);
+        if (iAttr.at("index"))
+            mIndex = iAttr.at("index").str();
+    }
+    for (size_t i=0; i<mExt.size(); i++)
+        if (mExt[i].empty() || (mExt[i][0] != '.'))
+            mExt[i] = "." + mExt[i];
+    mRecent = 0;
+    mPending = 0;
+    mStop = false;
+    mGeneration = 0;
+}
+
+
+/**
+ * Splits a path string into the offsets of its file name and extension, with
+ * the same semantics as std::filesystem, but without constructing any paths.
+ */
+static void split(const std::string& iPath, size_t& oName, size_t& oExt)
+{
+    size_t slash = iPath.rfind('/');
+    oName = (slash == std::string::npos) ? 0 : slash + 1;
+    size_t dot = iPath.rfind('.');
+    oExt = ((dot == std::string::npos) || (dot <= oName))
+        ? iPath.size() : dot;
+    if (iPath.compare(oName, std::string::npos, "..") == 0)
+        oExt = iPath.size();
+}
+
+
+/** True if the file name of iPath passes the filters */
+bool walker::match(const std::string& iPath) const
+{
+    size_t name;
+    size_t ext;
+    split(iPath, name, ext);
+    if (mExt.size())
+    {
+        bool found = false;
+        for (size_t i=0; !found && (i<mExt.size()); i++)
+            found = (iPath.compare(ext, std::string::npos, mExt[i]) == 0);
+        if (!found)
+            return false;
+    }
+    if (mGlob.size())
+    {
+        const char* n = iPath.c_str() + name;
+        bool found = false;
+        for (size_t i=0; !found && (i<mGlob.size()); i++)
+            found = (fnmatch(mGlob[i].c_str(), n, 0) == 0);
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+
+void walker::give(int iWorker, std::string iDir)
+{
+    mPending++;
+    {
+        std::lock_guard<std::mutex> lock(mQueue[iWorker].mutex);
+        mQueue[iWorker].dirs.push_back(std::move(iDir));
+    }
+    wake(false);
+}
+
+
+/**
+ * Tells idle workers that something changed: one, for a new directory, or
+ * all, for the end of the walk.
+ */
+void walker::wake(bool iAll)
+{
+    {
+        std::lock_guard<std::mutex> lock(mIdleMutex);
+        mGeneration++;
+    }
+    if (iAll)
+        mIdle.notify_all();
+    else
+        mIdle.notify_one();
+}
+
+
+/** Takes a directory from the worker's own queue, or steals one */
+bool walker::take(int iWorker, std::string& oDir)
+{
+    {
+        queue& q = mQueue[iWorker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.dirs.size())
+        {
+            oDir = std::move(q.dirs.back());
+            q.dirs.pop_back();
+            return true;
+        }
+    }
+    for (int i=1; i<mThreads; i++)
+    {
+        queue& q = mQueue[(iWorker + i) % mThreads];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.dirs.size())
+        {
+            oDir = std::move(q.dirs.front());
+            q.dirs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static int64_t ticks(fs::file_time_type iTime)
+{
+    return iTime.time_since_epoch().count();
+}
+
+
+/**
+ * Returns the entries of directory iDir, from the index if the directory
+ * hasn't changed since it was recorded, otherwise by reading it.  Without an
+ * index, nothing is looked up and nothing but the names is kept.
+ */
+const walker::record& walker::list(int iWorker, const std::string& iDir)
+{
+    if (mIndex.empty())
+    {
+        record& r = mScratch[iWorker];
+        r.entries.clear();
+        fs::directory_iterator end;
+        for (fs::directory_iterator it(iDir); it != end; it++)
+            r.entries.push_back({
+                it->path().filename().string(), 0, 0,
+                it->is_directory() && !it->is_symlink()
+            });
+        return r;
+    }
+
+    // A directory changed in the same clock tick as the walk might change
+    // again without its time changing, so it's marked to be read next time
+    int64_t mtime = ticks(fs::last_write_time(iDir));
+    mRecord[iWorker].emplace_back(iDir, record());
+    record& r = mRecord[iWorker].back().second;
+    std::unordered_map<std::string, record>::const_iterator c =
+        mCache.find(iDir);
+    if ((c != mCache.end()) && (c->second.mtime == mtime))
+    {
+        r = c->second;
+        return r;
+    }
+    r.mtime = (mtime < mRecent) ? mtime : -1;
+    fs::directory_iterator end;
+    for (fs::directory_iterator it(iDir); it != end; it++)
+    {
+        std::error_code ec;
+        entry e;
+        e.name = it->path().filename().string();
+        e.dir = it->is_directory() && !it->is_symlink();
+        e.size = e.dir ? 0 : it->file_size(ec);
+        if (ec)
+            e.size = -1;
+        e.mtime = ticks(it->last_write_time(ec));
+        if (ec)
+            e.mtime = -1;
+        r.entries.push_back(std::move(e));
+    }
+    return r;
+}
+
+
+/**
+ * Worker thread.  A directory is only counted as done once its
+ * subdirectories are queued, so the pending count reaching zero means the
+ * walk is complete.  Symbolic links to directories are listed but not
+ * followed, as for recursive_directory_iterator.  A worker with nothing to
+ * take sleeps until a directory is queued or the walk ends; it notes the
+ * generation before looking, so a directory queued in between isn't missed.
+ */
+void walker::work(int iWorker, std::vector<std::string>& oFound)
+{
+    std::string dir;
+    while (!mStop)
+    {
+        long generation;
+        {
+            std::lock_guard<std::mutex> lock(mIdleMutex);
+            generation = mGeneration;
+        }
+        if (!take(iWorker, dir))
+        {
+            std::unique_lock<std::mutex> lock(mIdleMutex);
+            mIdle.wait(lock, [&]{
+                return (mGeneration != generation) || (mPending == 0) || mStop;
+            });
+            if (mPending == 0)
+                return;
+            continue;
+        }
+        try
+        {
+            const record& r = list(iWorker, dir);
+            std::string base = dir;
+            if (base.size() && (base.back() != '/'))
+                base += '/';
+            for (size_t i=0; i<r.entries.size(); i++)
+            {
+                std::string p = base + r.entries[i].name;
+                if (r.entries[i].dir)
+                    give(iWorker, p);
+                if (match(p))
+                    oFound.push_back(std::move(p));
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mErrorMutex);
+            if (!mError)
+                mError = std::current_exception();
+            mStop = true;
+            wake(true);
+        }
+        if (--mPending == 0)
+            wake(true);
+    }
+}
+
+
+/**
+ * Returns the paths under iRoot that pass the filters, sorted.
+ */
+std::vector<std::string> walker::walk(const fs::path& iRoot)
+{
+    mQueue.resize(mThreads);
+    mRecord.resize(mThreads);
+    mScratch.resize(mThreads);
+    if (mIndex.size())
+    {
+        mRecent = ticks(
+            fs::file_time_type::clock::now() - std::chrono::seconds(2)
+        );
+        load();
+    }
+    std::vector< std::vector<std::string> > found(mThreads);
+    give(0, iRoot.string());
+    std::vector<std::thread> thread;
+    for (int t=1; t<mThreads; t++)
+        thread.emplace_back(&walker::work, this, t, std::ref(found[t]));
+    work(0, found[0]);
+    for (size_t t=0; t<thread.size(); t++)
+        thread[t].join();
+    if (mError)
+        std::rethrow_exception(mError);
+    if (mIndex.size())
+        save();
+
+    size_t n = 0;
+    for (int t=0; t<mThreads; t++)
+        n += found[t].size();
+    std::vector<std::string> all;
+    all.reserve(n);
+    for (int t=0; t<mThreads; t++)
+    {
+        std::move(found[t].begin(), found[t].end(), std::back_inserter(all));
+        found[t].clear();
+        found[t].shrink_to_fit();
+    }
+    std::sort(all.begin(), all.end());
+    return all;
+}
+
+
+/*
+ * The index file is native binary: a magic string, then the number of
+ * directories, then for each directory its path, time, number of entries,
+ * and the name, size, time and directory flag of each entry.  Strings are a
+ * 32 bit length followed by the characters.
+ */
+static const char sMagic[8] = {'L', 'U', 'B', 'E', 'I', 'D', 'X', '1'};
+
+template<class T>
+static void put(std::string& oBuf, T iVal)
+{
+    oBuf.append((const char*)&iVal, sizeof(T));
+}
+
+static void put(std::string& oBuf, const std::string& iStr)
+{
+    put<uint32_t>(oBuf, iStr.size());
+    oBuf.append(iStr);
+}
+
+/** Reads a value from the buffer, or returns false if it's too short */
+template<class T>
+static bool get(const char*& ioPtr, const char* iEnd, T& oVal)
+{
+    if (iEnd - ioPtr < (long)sizeof(T))
+        return false;
+    std::memcpy(&oVal, ioPtr, sizeof(T));
+    ioPtr += sizeof(T);
+    return true;
+}
+
+static bool get(const char*& ioPtr, const char* iEnd, std::string& oStr)
+{
+    uint32_t size;
+    if (!get(ioPtr, iEnd, size) || (iEnd - ioPtr < (long)size))
+        return false;
+    oStr.assign(ioPtr, size);
+    ioPtr += size;
+    return true;
+}
+
+
+/**
+ * Reads the index into the cache.  The index is only a cache, so if it's
+ * missing or unreadable the walk just reads everything.
+ */
+void walker::load()
+{
+    std::ifstream is(mIndex, std::ios::binary);
+    if (!is)
+        return;
+    std::string buf(
+        (std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()
+    );
+    const char* p = buf.data();
+    const char* end = p + buf.size();
+    if ((buf.size() < sizeof(sMagic)) ||
+        std::memcmp(p, sMagic, sizeof(sMagic)))
+        return;
+    p += sizeof(sMagic);
+    uint64_t dirs;
+    if (!get(p, end, dirs))
+        return;
+    mCache.reserve(dirs);
+    for (uint64_t d=0; d<dirs; d++)
+    {
+        std::string path;
+        record r;
+        uint32_t n;
+        if (!get(p, end, path) || !get(p, end, r.mtime) || !get(p, end, n))
+            break;
+        r.entries.resize(n);
+        for (uint32_t i=0; i<n; i++)
+        {
+            entry& e = r.entries[i];
+            uint8_t dir;
+            if (!get(p, end, e.name) || !get(p, end, e.size) ||
+                !get(p, end, e.mtime) || !get(p, end, dir))
+            {
+                mCache.clear();
+                return;
+            }
+            e.dir = dir;
+        }
+        mCache[path] = std::move(r);
+    }
+}
+
+
+/**
+ * Writes the directories of this walk to the index.  It's written to a
+ * temporary file that is then renamed, so a concurrent reader sees either
+ * the old index or the new one.
+ */
+void walker::save()
+{
+    std::string buf(sMagic, sizeof(sMagic));
+    uint64_t dirs = 0;
+    for (int t=0; t<mThreads; t++)
+        dirs += mRecord[t].size();
+    put(buf, dirs);
+    for (int t=0; t<mThreads; t++)
+        for (size_t d=0; d<mRecord[t].size(); d++)
+        {
+            const record& r = mRecord[t][d].second;
+            put(buf, mRecord[t][d].first);
+            put(buf, r.mtime);
+            put<uint32_t>(buf, r.entries.size());
+            for (size_t i=0; i<r.entries.size(); i++)
+            {
+                const entry& e = r.entries[i];
+                put(buf, e.name);
+                put(buf, e.size);
+                put(buf, e.mtime);
+                put<uint8_t>(buf, e.dir);
+            }
+        }
+    std::string tmp = mIndex + ".tmp";
+    std::ofstream os(tmp, std::ios::binary);
+    os.write(buf.data(), buf.size());
+    os.close();
+    if (!os)
+        throw error("walker::save(): can't write index");
+    fs::rename(tmp, mIndex);
+}
+
+
 Path::Path(var iArg)
 {
     mPath = iArg ? iArg.str() : fs::current_path();
 }
 
-var bits(fs::path iPath)
+
+/**
+ * The parent, stem and extension of a path
+ */
+static var bits(const std::string& iPath)
 {
+    size_t name;
+    size_t ext;
+    split(iPath, name, ext);
     var val;
-    val[2] = iPath.extension().string().c_str();
-    val[1] = iPath.stem().string().c_str();
-    val[0] = iPath.parent_path().string().c_str();
+    val[2] = iPath.substr(ext).c_str();
+    val[1] = iPath.substr(name, ext - name).c_str();
+    val[0] = iPath.substr(0, name ? name - 1 : 0).c_str();
     return val;
 }
 
+
+/**
+ * Builds a map from sorted keys.  Each key can then just be put on the end,
+ * so the map is built in one pass with no searching or insertion into the
+ * middle.
+ */
+static var sorted(const std::vector<std::string>& iKeys, bool iVal)
+{
+    var dir;
+    if (iKeys.empty())
+        return dir;
+    dir[nil];
+    dir.presize(iKeys.size());
+    for (size_t i=0; i<iKeys.size(); i++)
+    {
+        dir.insert(iKeys[i].c_str(), i);
+        if (iVal)
+            dir.at(i) = bits(iKeys[i]);
+    }
+    return dir;
+}
+
+
 var Path::dir(bool iVal)
 {
     if (!exists(mPath))
         throw error("dir: path doesn't exist");
 
-    var dir;
+    std::vector<std::string> keys;
     fs::directory_iterator end;
     for (fs::directory_iterator it(mPath); it != end; it++)
-        dir[it->path().string().c_str()] = iVal ? bits(it->path()) : nil;
-    return dir;
+        keys.push_back(it->path().string());
+    std::sort(keys.begin(), keys.end());
+    return sorted(keys, iVal);
 }
 
+
 var Path::rdir(bool iVal)
+{
+    return find(nil, iVal);
+}
+
+
+var Path::find(var iAttr, bool iVal)
 {
     if (!exists(mPath))
         throw error("rdir: path doesn't exist");
 
-    var dir;
     if (!fs::is_directory(mPath))
     {
-        dir[mPath.string().c_str()] = iVal ? bits(mPath) : nil;
+        var dir;
+        dir[mPath.string().c_str()] = iVal ? bits(mPath.string()) : nil;
         return dir;
     }
 
-    fs::recursive_directory_iterator end;
-    for (fs::recursive_directory_iterator it(mPath); it != end; it++)
-        dir[it->path().string().c_str()] = iVal ? bits(it->path()) : nil;
-    return dir;
+    walker w(iAttr);
+    return sorted(w.walk(mPath), iVal);
 }
 
+
 var Path::tree()
 {
     return tree(mPath);
 }
 
+
 var Path::tree(std::filesystem::path iPath)
 {
     if (!exists(iPath))
         throw error("tree: path doesn't exist");
 
-    var dir;
+    std::vector<fs::path> entries;
     fs::directory_iterator end;
     for (fs::directory_iterator it(iPath); it != end; it++)
-        if (fs::is_directory(*it))
-            dir[it->path().filename().string().c_str()] = tree(*it);
-        else
-            dir[it->path().filename().string().c_str()] = nil;
+        entries.push_back(it->path());
+    std::sort(
+        entries.begin(), entries.end(),
+        [](const fs::path& a, const fs::path& b) {
+            return a.filename().string() < b.filename().string();
+        }
+    );
+
+    var dir;
+    if (entries.empty())
+        return dir;
+    dir[nil];
+    dir.presize(entries.size());
+    for (size_t i=0; i<entries.size(); i++)
+    {
+        dir.insert(entries[i].filename().string().c_str(), i);
+        if (fs::is_directory(entries[i]))
+            dir.at(i) = tree(entries[i]);
+    }
 
     return dir;
 }
-
@@ -14,12 +14,24 @@
 
 namespace libube
 {
-    /** Virtual interface to path module */
+    /**
+     * Virtual interface to path module
+     *
+     * rdir() and find() walk the tree on several threads.  find() is rdir()
+     * with attributes, which may contain:
+     *  - "glob": a shell pattern, or array of them, that file names must match
+     *  - "ext": an extension (e.g., ".wav"), or array of them
+     *  - "threads": the number of threads; zero or fewer is one per core
+     *  - "index": an index file.  The listing of every directory is saved
+     *    there, and on the next call any directory that hasn't been modified
+     *    is taken from it rather than read again.
+     */
     class path : public Module
     {
     public:
         virtual var dir(bool iVal=false) = 0;
         virtual var rdir(bool iVal=false) = 0;
+        virtual var find(var iAttr, bool iVal=false) = 0;
         virtual var tree() = 0;
     };
 
@@ -0,0 +1,380 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <tuple>
+
+#include "lube/resample.h"
+
+
+/**
+ * A polyphase filter bank
+ *
+ * Output sample n is at input time t = n*M/L, i.e., between input samples
+ * i = floor(t) and i+1 at phase p = n*M mod L.  Row p of the bank holds the
+ * 2W taps that apply to inputs i-W+1 to i+W.
+ */
+struct libube::FilterBank
+{
+    int L;      ///< Interpolation factor
+    int M;      ///< Decimation factor
+    int W;      ///< Half the number of taps
+    int taps;
+    std::vector<float> f;
+    std::vector<double> d;
+};
+
+
+using namespace libube;
+
+
+/** Zeroth order modified Bessel function of the first kind */
+static double bessel0(double iX)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k=1; k<50; k++)
+    {
+        term *= (iX / (2.0 * k)) * (iX / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-16)
+            break;
+    }
+    return sum;
+}
+
+
+/**
+ * Designs the filter bank for the ratio L/M.  The cutoff is a little below
+ * the lower of the two Nyquist frequencies; each phase is normalised to unit
+ * gain at DC.
+ */
+static std::shared_ptr<const FilterBank> design(int iL, int iM, int iZeros)
+{
+    const double beta = 8.6;
+    const double rolloff = 0.95;
+    std::shared_ptr<FilterBank> b = std::make_shared<FilterBank>();
+    b->L = iL;
+    b->M = iM;
+    double c = rolloff * std::min(1.0, (double)iL / iM);
+    b->W = (int)std::ceil(iZeros / c);
+    b->taps = 2 * b->W;
+    b->d.resize(iL * b->taps);
+    b->f.resize(iL * b->taps);
+    double i0 = bessel0(beta);
+    for (int p=0; p<iL; p++)
+    {
+        double* h = &b->d[p * b->taps];
+        double sum = 0.0;
+        for (int k=0; k<b->taps; k++)
+        {
+            double t = (double)p / iL + b->W - 1 - k;
+            double x = t / b->W;
+            double w = (x*x < 1.0)
+                ? bessel0(beta * std::sqrt(1.0-x*x)) / i0 : 0;
+            double s = (t == 0.0)
+                ? 1.0 : std::sin(M_PI * c * t) / (M_PI * c * t);
+            h[k] = c * s * w;
+            sum += h[k];
+        }
+        for (int k=0; k<b->taps; k++)
+        {
+            h[k] /= sum;
+            b->f[p * b->taps + k] = (float)h[k];
+        }
+    }
+    return b;
+}
+
+
+/**
+ * Returns the bank for the ratio iTo/iFrom, designing it the first time.
+ */
+static std::shared_ptr<const FilterBank> bank(int iFrom, int iTo, int iZeros)
+{
+    static std::mutex sMutex;
+    static std::map<
+        std::tuple<int, int, int>, std::shared_ptr<const FilterBank>
+    > sCache;
+    if ((iFrom <= 0) || (iTo <= 0) || (iZeros <= 0))
+        throw error("Resample: rates and zeros must be positive");
+    int g = std::gcd(iFrom, iTo);
+    std::tuple<int, int, int> key(iTo / g, iFrom / g, iZeros);
+    std::lock_guard<std::mutex> lock(sMutex);
+    std::shared_ptr<const FilterBank>& b = sCache[key];
+    if (!b)
+        b = design(iTo / g, iFrom / g, iZeros);
+    return b;
+}
+
+
+/**
+ * Computes output samples [iN0, iN1) from the inputs iX, which hold input
+ * samples [iBase, iBase+iLen); inputs outside that are zero.  Four partial
+ * sums keep the dependency chain short.
+ */
+template<class X, class H, class Y>
+static void polyphase(
+    const FilterBank& iBank, const H* iH,
+    const X* iX, long iBase, long iLen, long iN0, long iN1, Y* oY
+)
+{
+    int taps = iBank.taps;
+    for (long n=iN0; n<iN1; n++)
+    {
+        long nm = n * iBank.M;
+        long j0 = nm / iBank.L - iBank.W + 1 - iBase;
+        const H* h = iH + (nm % iBank.L) * taps;
+        H acc = 0;
+        if ((j0 >= 0) && (j0 + taps <= iLen))
+        {
+            const X* x = iX + j0;
+            H a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+            int k = 0;
+            for (; k+4<=taps; k+=4)
+            {
+                a0 += h[k]   * x[k];
+                a1 += h[k+1] * x[k+1];
+                a2 += h[k+2] * x[k+2];
+                a3 += h[k+3] * x[k+3];
+            }
+            for (; k<taps; k++)
+                a0 += h[k] * x[k];
+            acc = (a0 + a1) + (a2 + a3);
+        }
+        else
+            for (int k=0; k<taps; k++)
+                if ((j0 + k >= 0) && (j0 + k < iLen))
+                    acc += h[k] * iX[j0 + k];
+        oY[n - iN0] = (Y)acc;
+    }
+}
+
+
+/**
+ * Batch resampling of one row, split across threads if it's long.
+ */
+template<class T>
+static void resample(
+    const FilterBank& iBank, const T* iH, const T* iX, long iLen, T* oY,
+    long iOut
+)
+{
+    const long minChunk = 1 << 16;
+    int threads = std::min<long>(
+        std::max(1u, std::thread::hardware_concurrency()), iOut / minChunk
+    );
+    if (threads <= 1)
+    {
+        polyphase(iBank, iH, iX, 0, iLen, 0, iOut, oY);
+        return;
+    }
+    std::vector<std::thread> thread;
+    for (int t=0; t<threads; t++)
+    {
+        long n0 = iOut * t / threads;
+        long n1 = iOut * (t+1) / threads;
+        thread.emplace_back(
+            polyphase<T, T, T>, std::cref(iBank), iH, iX, 0, iLen, n0, n1,
+            oY + n0
+        );
+    }
+    for (int t=0; t<threads; t++)
+        thread[t].join();
+}
+
+
+Resample::Resample(int iFrom, int iTo, int iZeros)
+{
+    mDim = 1;
+    mBank = bank(iFrom, iTo, iZeros);
+}
+
+
+var Resample::alloc(var iVar) const
+{
+    if ((iVar.atype() != TYPE_FLOAT) && (iVar.atype() != TYPE_DOUBLE))
+        throw error("Resample::alloc(): type must be float or double");
+    var s = iVar.shape();
+    long n = s[s.size()-1].get<int>();
+    s[s.size()-1] = (int)((n * mBank->L + mBank->M - 1) / mBank->M);
+    return view(s, iVar.atype() == TYPE_DOUBLE ? var(0.0) : var(0.0f));
+}
+
+
+void Resample::vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const
+{
+    long len = iVar.shape(-1);
+    long out = oVar.shape(-1);
+    switch (iVar.atype())
+    {
+    case TYPE_FLOAT:
+        resample<float>(
+            *mBank, mBank->f.data(), iVar.ptr<float>(iOffsetI), len,
+            oVar.ptr<float>(iOffsetO), out
+        );
+        break;
+    case TYPE_DOUBLE:
+        resample<double>(
+            *mBank, mBank->d.data(), iVar.ptr<double>(iOffsetI), len,
+            oVar.ptr<double>(iOffsetO), out
+        );
+        break;
+    default:
+        throw error("Resample::vector(): type must be float or double");
+    }
+}
+
+
+ResampleStream::ResampleStream(int iFrom, int iTo, int iZeros)
+    : Resample(iFrom, iTo, iZeros)
+{
+    reset();
+}
+
+
+/**
+ * Forgets the history, ready for a new signal.
+ */
+void ResampleStream::reset()
+{
+    mHistory.clear();
+    mShape = nil;
+    mType = 0;
+    mIn = 0;
+    mOut = 0;
+    mBase = 0;
+    mEnd = 0;
+}
+
+
+/**
+ * The number of outputs that can be computed from iIn inputs; output n needs
+ * input floor(n*M/L) + W.
+ */
+long ResampleStream::end(long iIn) const
+{
+    long e = (iIn - mBank->W) * mBank->L;
+    if (e <= 0)
+        return mOut;
+    return std::max(mOut, (e + mBank->M - 1) / mBank->M);
+}
+
+
+var ResampleStream::alloc(var iVar) const
+{
+    if ((iVar.atype() != TYPE_FLOAT) && (iVar.atype() != TYPE_DOUBLE))
+        throw error("ResampleStream::alloc(): type must be float or double");
+    var s = iVar.shape();
+    s[s.size()-1] = (int)(end(mIn + s[s.size()-1].get<int>()) - mOut);
+    return view(s, iVar.atype() == TYPE_DOUBLE ? var(0.0) : var(0.0f));
+}
+
+
+/**
+ * Broadcasts over the channels, then moves the stream on.
+ */
+void ResampleStream::scalar(const var& iVar, var& oVar) const
+{
+    long len = iVar.shape(-1);
+    int channels = iVar.size() / std::max(len, 1L);
+    if (mShape && (mHistory.size() != (size_t)channels))
+        throw error("ResampleStream: number of channels changed");
+    mHistory.resize(channels);
+    mShape = iVar.shape();
+    mType = iVar.atype();
+    mEnd = end(mIn + len);
+    if (oVar.shape(-1) != mEnd - mOut)
+        throw error("ResampleStream: wrong output size");
+    if (len > 0)
+        broadcast(iVar, oVar);
+    mIn += len;
+    mOut = mEnd;
+    long base = std::max(
+        mBase, mOut * mBank->M / mBank->L - mBank->W + 1
+    );
+    for (int c=0; c<channels; c++)
+        mHistory[c].erase(
+            mHistory[c].begin(), mHistory[c].begin() + (base - mBase)
+        );
+    mBase = base;
+}
+
+
+/**
+ * Appends the block to the channel's history and computes what it can.
+ */
+void ResampleStream::vector(
+    var iVar, ind iOffsetI, var& oVar, ind iOffsetO
+) const
+{
+    long len = iVar.shape(-1);
+    std::vector<double>& h = mHistory[iOffsetI / len];
+    switch (iVar.atype())
+    {
+    case TYPE_FLOAT:
+    {
+        const float* x = iVar.ptr<float>(iOffsetI);
+        h.insert(h.end(), x, x + len);
+        polyphase(
+            *mBank, mBank->d.data(), h.data(), mBase, (long)h.size(),
+            mOut, mEnd, oVar.ptr<float>(iOffsetO)
+        );
+        break;
+    }
+    case TYPE_DOUBLE:
+    {
+        const double* x = iVar.ptr<double>(iOffsetI);
+        h.insert(h.end(), x, x + len);
+        polyphase(
+            *mBank, mBank->d.data(), h.data(), mBase, (long)h.size(),
+            mOut, mEnd, oVar.ptr<double>(iOffsetO)
+        );
+        break;
+    }
+    default:
+        throw error("ResampleStream::vector(): type must be float or double");
+    }
+}
+
+
+/**
+ * Returns the rest of the output, as if the input were followed by zeros,
+ * and resets the stream.
+ */
+var ResampleStream::flush()
+{
+    if (!mShape)
+        return nil;
+    long total = (mIn * mBank->L + mBank->M - 1) / mBank->M;
+    var s = mShape;
+    s[s.size()-1] = (int)(total - mOut);
+    var r = view(s, mType == TYPE_DOUBLE ? var(0.0) : var(0.0f));
+    int rlen = total - mOut;
+    for (size_t c=0; c<mHistory.size(); c++)
+    {
+        const std::vector<double>& h = mHistory[c];
+        if (mType == TYPE_DOUBLE)
+            polyphase(
+                *mBank, mBank->d.data(), h.data(), mBase, (long)h.size(),
+                mOut, total, r.ptr<double>(c * rlen)
+            );
+        else
+            polyphase(
+                *mBank, mBank->d.data(), h.data(), mBase, (long)h.size(),
+                mOut, total, r.ptr<float>(c * rlen)
+            );
+    }
+    reset();
+    return r;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <memory>
+#include <vector>
+#include <lube/var.h>
+
+namespace libube
+{
+    struct FilterBank;
+
+    /**
+     * Resampling functor
+     *
+     * Polyphase sample rate conversion from iFrom to iTo Hz (only the ratio
+     * matters) along the last dimension of a float or double array, so a
+     * [channels x frames] view is resampled channel by channel.  The
+     * anti-aliasing filter is a Kaiser windowed sinc with iZeros zero
+     * crossings either side.  Filter banks are cached by ratio and shared
+     * between instances.  Long signals are split across threads.
+     */
+    class Resample : public UnaryFunctor
+    {
+    public:
+        Resample(int iFrom, int iTo, int iZeros=16);
+    protected:
+        std::shared_ptr<const FilterBank> mBank;
+        var alloc(var iVar) const;
+        void vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const;
+    };
+
+    /**
+     * Streaming resampling functor
+     *
+     * As Resample, but the input arrives in consecutive blocks.  The tail of
+     * each channel is kept between calls, so the concatenated output is the
+     * same as for the whole signal; it is just emitted later, as each sample
+     * waits for the filter length of input after it.  flush() returns what
+     * remains at the end.  Each block yields however many samples can be
+     * computed, which may be none.
+     */
+    class ResampleStream : public Resample
+    {
+    public:
+        ResampleStream(int iFrom, int iTo, int iZeros=16);
+        var flush();
+        void reset();
+    protected:
+        var alloc(var iVar) const;
+        void scalar(const var& iVar, var& oVar) const;
+        void vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const;
+    private:
+        mutable std::vector< std::vector<double> > mHistory;
+        mutable var mShape;  ///< Shape of the last block
+        mutable int mType;   ///< Type of the last block
+        mutable long mIn;    ///< Input samples so far
+        mutable long mOut;   ///< Output samples so far
+        mutable long mBase;  ///< Input index of the start of the history
+        mutable long mEnd;   ///< Output samples after the current block
+        long end(long iIn) const;
+    };
+}
+
+#endif // RESAMPLE_H
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#ifndef SND_H
+#define SND_H
+
+#include <cstdio>
+#include <lube/module.h>
+
+namespace libube
+{
+    /**
+     * Virtual interface to the audio file module
+     *
+     * Beyond the file interface, which reads or writes a whole file, a file
+     * can be opened and streamed in blocks of frames.  Blocks are
+     * [channels x frames] views, or plain arrays for mono.  The attribute var
+     * passed at creation may contain "type", an exemplar of the sample type:
+     * float (default), double, or int, which holds 16 bit samples.  When
+     * writing, "rate" and "channels" give the format; when reading they are
+     * set along with "frames".
+     */
+    class snd : public file
+    {
+    public:
+        using file::read;
+        using file::write;
+        virtual void open(var iFile, char iMode='r') = 0;
+        virtual int read(var& ioBlock, int iFrames) = 0;
+        virtual void write(var iBlock) = 0;
+        virtual long seek(long iFrame, int iWhence=SEEK_SET) = 0;
+        virtual void close() = 0;
+    };
+
+    /** Module specialised to read and write audio files */
+    class sndmodule : public module
+    {
+    public:
+        sndmodule() : module("snd") {}
+        snd& create(var iArg=nil) {
+            return dynamic_cast<snd&>(module::create(iArg));
+        }
+    };
+};
+
+#endif // SND_H
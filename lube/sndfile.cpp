@@ -7,19 +7,43 @@
  *   Phil Garner, December 2013
  */
 
+#include <algorithm>
+#include <type_traits>
+#include <vector>
 #include <sndfile.h>
-#include <lube/module.h>
+#include <lube/snd.h>
 
 namespace libube
 {
-    class sndfile : public file
+    /**
+     * Audio file handler
+     *
+     * Whole files are read and written via the same block streaming as the
+     * snd interface, so multi-channel data are (de)interleaved a block at a
+     * time rather than transposed.
+     */
+    class sndfile : public snd
     {
     public:
-        sndfile(var iAttr) { mAttr = iAttr; };
+        sndfile(var iAttr) { mAttr = iAttr; mSnd = 0; };
+        virtual ~sndfile() { close(); };
         virtual var read(var iFile);
         virtual void write(var iFile, var iVar);
+        virtual void open(var iFile, char iMode='r');
+        virtual int read(var& ioBlock, int iFrames);
+        virtual void write(var iBlock);
+        virtual long seek(long iFrame, int iWhence=SEEK_SET);
+        virtual void close();
     private:
         var mAttr;
+        SNDFILE* mSnd;
+        SF_INFO mInfo;
+        std::vector<char> mBuf;
+        var type();
+        template<class T, class S>
+        int readf(T* oData, int iStride, int iFrames);
+        template<class T, class S>
+        void writef(const T* iData, int iStride, int iFrames);
     };
 
 
@@ -37,51 +61,267 @@ using namespace libube;
  * http://www.mega-nerd.com/libsndfile/api.html
  */
 
-var sndfile::read(var iFile)
+/** Frames per interleaved buffer */
+const int BLOCK = 4096;
+
+/*
+ * Overloads on the sample type of the libsndfile calls
+ */
+static sf_count_t sfRead(SNDFILE* iSnd, float* oPtr, sf_count_t iFrames)
 {
-    // Open the file
-    SF_INFO sfInfo;
-    sfInfo.format = 0;
-    SNDFILE* snd = sf_open(iFile.str(), SFM_READ, &sfInfo);
-    if (!snd)
-        throw error("sndfile::read: Failed to open file");
-
-    // Read stuff
-    mAttr["rate"] = sfInfo.samplerate;
-    int size = sfInfo.frames * sfInfo.channels;
-    var data = 0.0f;
-    data.resize(size);
-    int nGot = sf_readf_float(snd, data.ptr<float>(), size);
-    if (nGot != size)
-        throw error("sndfile::read: Size fuckup");
-    if (sfInfo.channels != 1)
-        // In place transpose for channels > 1
-        data = data.view({(int)sfInfo.frames, sfInfo.channels}).transpose();
-    sf_close(snd);
-    return data;
+    return sf_readf_float(iSnd, oPtr, iFrames);
 }
 
-void sndfile::write(var iFile, var iVar)
+static sf_count_t sfRead(SNDFILE* iSnd, double* oPtr, sf_count_t iFrames)
+{
+    return sf_readf_double(iSnd, oPtr, iFrames);
+}
+
+static sf_count_t sfRead(SNDFILE* iSnd, short* oPtr, sf_count_t iFrames)
+{
+    return sf_readf_short(iSnd, oPtr, iFrames);
+}
+
+static sf_count_t sfWrite(SNDFILE* iSnd, const float* iPtr, sf_count_t iFrames)
+{
+    return sf_writef_float(iSnd, iPtr, iFrames);
+}
+
+static sf_count_t sfWrite(SNDFILE* iSnd, const double* iPtr,
+                          sf_count_t iFrames)
+{
+    return sf_writef_double(iSnd, iPtr, iFrames);
+}
+
+static sf_count_t sfWrite(SNDFILE* iSnd, const short* iPtr, sf_count_t iFrames)
+{
+    return sf_writef_short(iSnd, iPtr, iFrames);
+}
+
+
+/**
+ * The sample type; an exemplar from the "type" attribute, or float.
+ */
+var sndfile::type()
 {
-    // Open the file
-    SF_INFO sfInfo;
-    sfInfo.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16 | SF_ENDIAN_FILE;
-    sfInfo.samplerate = mAttr["rate"].get<int>();
-    sfInfo.channels = iVar.dim() > 1 ? iVar.shape(0) : 1;
-    SNDFILE* snd = sf_open(iFile.str(), SFM_WRITE, &sfInfo);
-    if (!snd)
-        throw error("sndfile::write: Failed to open file");
-
-    // Write stuff
-    int n;
-    if (iVar.dim() > 1)
+    var t = (mAttr && mAttr.at("type")) ? mAttr.at("type") : var(0.0f);
+    switch (t.atype())
+    {
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+    case TYPE_INT:
+        return t;
+    default:
+        throw error("sndfile: type must be float, double or int");
+    }
+}
+
+
+void sndfile::open(var iFile, char iMode)
+{
+    close();
+    if (iMode == 'w')
+    {
+        mInfo.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16 | SF_ENDIAN_FILE;
+        mInfo.samplerate = mAttr["rate"].get<int>();
+        mInfo.channels = mAttr.at("channels")
+            ? mAttr.at("channels").get<int>() : 1;
+        mSnd = sf_open(iFile.str(), SFM_WRITE, &mInfo);
+        if (!mSnd)
+            throw error("sndfile::open: Failed to open file for writing");
+    }
+    else
     {
-        var tr = transpose(iVar);
-        n = (int)sf_writef_float(snd, tr.ptr<float>(), tr.size());
+        mInfo.format = 0;
+        mSnd = sf_open(iFile.str(), SFM_READ, &mInfo);
+        if (!mSnd)
+            throw error("sndfile::open: Failed to open file");
+        mAttr["rate"] = mInfo.samplerate;
+        mAttr["channels"] = mInfo.channels;
+        mAttr["frames"] = (long)mInfo.frames;
     }
+}
+
+
+void sndfile::close()
+{
+    if (mSnd)
+        sf_close(mSnd);
+    mSnd = 0;
+}
+
+
+long sndfile::seek(long iFrame, int iWhence)
+{
+    if (!mSnd)
+        throw error("sndfile::seek: File not open");
+    sf_count_t r = sf_seek(mSnd, iFrame, iWhence);
+    if (r < 0)
+        throw error("sndfile::seek: Seek failed");
+    return r;
+}
+
+
+/**
+ * Reads up to iFrames frames into channel rows iStride apart.  The libsndfile
+ * sample type S may be narrower than the array type T.  Mono data of the same
+ * type are read in place; otherwise a block of interleaved frames at a time
+ * is scattered into the rows.  Frames beyond the end of file are zeroed.
+ */
+template<class T, class S>
+int sndfile::readf(T* oData, int iStride, int iFrames)
+{
+    int channels = mInfo.channels;
+    int got = 0;
+    if ((channels == 1) && std::is_same<T, S>::value)
+        got = sfRead(mSnd, (S*)oData, iFrames);
     else
-        n = (int)sf_writef_float(snd, iVar.ptr<float>(), iVar.size());
-    sf_close(snd);
-    if (iVar.size() != n)
-        throw error("sndfile::write: Size fuckup");
+    {
+        mBuf.resize(sizeof(S) * BLOCK * channels);
+        S* buf = (S*)mBuf.data();
+        while (got < iFrames)
+        {
+            int want = std::min(iFrames - got, BLOCK);
+            int n = (int)sfRead(mSnd, buf, want);
+            for (int c=0; c<channels; c++)
+            {
+                T* o = oData + c * iStride + got;
+                const S* b = buf + c;
+                for (int f=0; f<n; f++)
+                    o[f] = b[f * channels];
+            }
+            got += n;
+            if (n < want)
+                break;
+        }
+    }
+    for (int c=0; c<channels; c++)
+        std::fill(oData + c * iStride + got, oData + c * iStride + iFrames, 0);
+    return got;
+}
+
+
+/**
+ * The converse of readf(); gathers channel rows into interleaved frames.
+ */
+template<class T, class S>
+void sndfile::writef(const T* iData, int iStride, int iFrames)
+{
+    int channels = mInfo.channels;
+    if ((channels == 1) && std::is_same<T, S>::value)
+    {
+        if (sfWrite(mSnd, (const S*)iData, iFrames) != iFrames)
+            throw error("sndfile::write: Write failed");
+        return;
+    }
+    mBuf.resize(sizeof(S) * BLOCK * channels);
+    S* buf = (S*)mBuf.data();
+    for (int done=0; done<iFrames; done+=BLOCK)
+    {
+        int n = std::min(iFrames - done, BLOCK);
+        for (int c=0; c<channels; c++)
+        {
+            const T* d = iData + c * iStride + done;
+            S* b = buf + c;
+            for (int f=0; f<n; f++)
+                b[f * channels] = (S)d[f];
+        }
+        if (sfWrite(mSnd, buf, n) != n)
+            throw error("sndfile::write: Write failed");
+    }
+}
+
+
+/**
+ * Reads the next iFrames frames into ioBlock, which is re-used if it is
+ * already of the right type and shape.  Returns the number of frames read.
+ */
+int sndfile::read(var& ioBlock, int iFrames)
+{
+    if (!mSnd)
+        throw error("sndfile::read: File not open");
+    var t = type();
+    int channels = mInfo.channels;
+    bool fit = ioBlock && (ioBlock.atype() == t.atype()) && (
+        (channels > 1)
+        ? (ioBlock.dim() == 2) &&
+          (ioBlock.shape(0) == channels) && (ioBlock.shape(1) == iFrames)
+        : (ioBlock.dim() == 1) && (ioBlock.size() == iFrames)
+    );
+    if (!fit)
+    {
+        if (channels > 1)
+            ioBlock = view({channels, iFrames}, t);
+        else
+        {
+            ioBlock = t;
+            ioBlock.array();
+            ioBlock.resize(iFrames);
+        }
+    }
+
+    int got;
+    switch (t.atype())
+    {
+    case TYPE_FLOAT:
+        got = readf<float, float>(ioBlock.ptr<float>(), iFrames, iFrames);
+        break;
+    case TYPE_DOUBLE:
+        got = readf<double, double>(ioBlock.ptr<double>(), iFrames, iFrames);
+        break;
+    default:
+        got = readf<int, short>(ioBlock.ptr<int>(), iFrames, iFrames);
+        break;
+    }
+    return got;
+}
+
+
+/**
+ * Writes a block of [channels x frames], or a plain array for mono.
+ */
+void sndfile::write(var iBlock)
+{
+    if (!mSnd)
+        throw error("sndfile::write: File not open");
+    int channels = iBlock.dim() > 1 ? iBlock.shape(0) : 1;
+    if (channels != mInfo.channels)
+        throw error("sndfile::write: Wrong number of channels");
+    int frames = iBlock.dim() > 1 ? iBlock.shape(1) : iBlock.size();
+    switch (iBlock.atype())
+    {
+    case TYPE_FLOAT:
+        writef<float, float>(iBlock.ptr<float>(), frames, frames);
+        break;
+    case TYPE_DOUBLE:
+        writef<double, double>(iBlock.ptr<double>(), frames, frames);
+        break;
+    case TYPE_INT:
+        writef<int, short>(iBlock.ptr<int>(), frames, frames);
+        break;
+    default:
+        throw error("sndfile::write: type must be float, double or int");
+    }
+}
+
+
+var sndfile::read(var iFile)
+{
+    open(iFile);
+    int frames = (int)mInfo.frames;
+    var data;
+    int got = read(data, frames);
+    close();
+    if (got != frames)
+        throw error("sndfile::read: Short read");
+    return data;
+}
+
+
+void sndfile::write(var iFile, var iVar)
+{
+    mAttr["channels"] = iVar.dim() > 1 ? iVar.shape(0) : 1;
+    open(iFile, 'w');
+    write(iVar);
+    close();
 }
@@ -0,0 +1,294 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#include <algorithm>
+#include <complex>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "lube/var.h"
+#include "lube/heap.h"
+#include "lube/math.h"
+
+using namespace libube;
+
+
+/**
+ * Sorts [iBegin, iEnd).  Large ranges are split into chunks that are sorted
+ * on separate threads and then merged pairwise, also in parallel.  iLess
+ * must be safe to call from several threads at once, so it can't touch the
+ * reference counts of vars.
+ */
+template<class T, class L>
+static void psort(T* iBegin, T* iEnd, L iLess)
+{
+    const long minChunk = 1 << 16;
+    long n = iEnd - iBegin;
+    int threads = std::min<long>(
+        std::max(1u, std::thread::hardware_concurrency()), n / minChunk
+    );
+    if (threads <= 1)
+    {
+        std::sort(iBegin, iEnd, iLess);
+        return;
+    }
+
+    std::vector<long> bound(threads+1);
+    for (int t=0; t<=threads; t++)
+        bound[t] = n * t / threads;
+    std::vector<std::thread> thread;
+    for (int t=0; t<threads; t++)
+        thread.emplace_back([=]{
+            std::sort(iBegin + bound[t], iBegin + bound[t+1], iLess);
+        });
+    for (int t=0; t<threads; t++)
+        thread[t].join();
+    for (int width=1; width<threads; width*=2)
+    {
+        thread.clear();
+        for (int t=0; t+width<threads; t+=2*width)
+        {
+            T* mid = iBegin + bound[t+width];
+            T* end = iBegin + bound[std::min(t+2*width, threads)];
+            thread.emplace_back([=]{
+                std::inplace_merge(iBegin + bound[t], mid, end, iLess);
+            });
+        }
+        for (size_t t=0; t<thread.size(); t++)
+            thread[t].join();
+    }
+}
+
+
+/**
+ * The indices that would sort iKey.  Ties are broken by index, so the order
+ * is stable whatever the underlying algorithm.
+ */
+template<class K, class L>
+static std::vector<int> order(const K* iKey, int iSize, L iLess, bool iPar)
+{
+    std::vector<int> idx(iSize);
+    std::iota(idx.begin(), idx.end(), 0);
+    auto less = [=](int a, int b) {
+        if (iLess(iKey[a], iKey[b]))
+            return true;
+        if (iLess(iKey[b], iKey[a]))
+            return false;
+        return a < b;
+    };
+    if (iPar)
+        psort(idx.data(), idx.data() + iSize, less);
+    else
+        std::sort(idx.begin(), idx.end(), less);
+    return idx;
+}
+
+
+template<class T>
+static std::vector<int> order(const T* iKey, int iSize)
+{
+    return order(iKey, iSize, std::less<T>(), true);
+}
+
+
+/** Complex numbers compare by magnitude, as for var::operator<() */
+template<class T>
+static std::vector<int> order(const std::complex<T>* iKey, int iSize)
+{
+    return order(
+        iKey, iSize,
+        [](const std::complex<T>& a, const std::complex<T>& b) {
+            return std::abs(a) < std::abs(b);
+        },
+        true
+    );
+}
+
+
+/**
+ * The indices that would sort the keys.  If the keys are all strings they are
+ * compared as C strings, which can be done in parallel; otherwise they are
+ * compared as vars, in this thread.
+ */
+static std::vector<int> order(const std::vector<var>& iKey)
+{
+    std::vector<const char*> str(iKey.size());
+    for (size_t i=0; i<iKey.size(); i++)
+    {
+        if (!iKey[i].heap() || !iKey[i].atype<char>())
+        {
+            str.clear();
+            break;
+        }
+        str[i] = iKey[i].str();
+    }
+    if (str.size())
+        return order(
+            str.data(), str.size(),
+            [](const char* a, const char* b) { return std::strcmp(a, b) < 0; },
+            true
+        );
+    return order(
+        iKey.data(), iKey.size(),
+        [](const var& a, const var& b) { return a < b; },
+        false
+    );
+}
+
+
+/**
+ * The indices that would sort a var.  Dense arrays are sorted by type;
+ * otherwise the elements (the values, for a map) or, if iKey is given, the
+ * value at iKey in each element are the keys.
+ */
+static std::vector<int> order(var iVar, var iKey)
+{
+    int n = iVar.size();
+    if (!iVar.heap())
+        return std::vector<int>(n, 0);
+    if (!iKey)
+        switch (iVar.atype())
+        {
+        case TYPE_CHAR: return order(iVar.ptr<char>(), n);
+        case TYPE_INT: return order(iVar.ptr<int>(), n);
+        case TYPE_LONG: return order(iVar.ptr<long>(), n);
+        case TYPE_FLOAT: return order(iVar.ptr<float>(), n);
+        case TYPE_DOUBLE: return order(iVar.ptr<double>(), n);
+        case TYPE_CFLOAT: return order(iVar.ptr<cfloat>(), n);
+        case TYPE_CDOUBLE: return order(iVar.ptr<cdouble>(), n);
+        default:
+            break;
+        }
+    else
+        if (!iVar.atype<var>() && !iVar.atype<pair>())
+            throw error("var::sort(): key given, but elements are not maps");
+
+    std::vector<var> key(n);
+    for (int i=0; i<n; i++)
+        key[i] = iKey ? iVar.at(i).at(iKey) : iVar.at(i);
+    return order(key);
+}
+
+
+template<class T>
+static void gather(const T* iSrc, const std::vector<int>& iIdx, T* oDst)
+{
+    for (size_t i=0; i<iIdx.size(); i++)
+        oDst[i] = iSrc[iIdx[i]];
+}
+
+
+/**
+ * Returns the indices that would sort the array, as an int array.  The sort
+ * is stable.  See sort() for the meaning of iKey.
+ */
+var var::argsort(var iKey) const
+{
+    if (!defined())
+        return nil;
+    std::vector<int> idx = order(*this, iKey);
+    var r = libube::view({(int)idx.size()}, 0);
+    std::copy(idx.begin(), idx.end(), r.ptr<int>());
+    return r;
+}
+
+
+/**
+ * Returns a sorted copy of the array.  Dense arrays are sorted by value; the
+ * sort is then parallel for large arrays.  Arrays of vars are sorted stably;
+ * if iKey is given, the elements must be maps, and are sorted by their value
+ * at iKey.  Maps are already sorted by key, so sorting one returns its
+ * values as a sorted array.
+ */
+var var::sort(var iKey) const
+{
+    if (!defined())
+        return nil;
+    if (!heap())
+        return *this;
+    if (!iKey && !atype<var>() && !atype<pair>() &&
+        !atype<cfloat>() && !atype<cdouble>())
+    {
+        var r = copy();
+        var v = r.view({r.size()});
+        libube::sort(v, v);
+        return r;
+    }
+
+    var self = *this;
+    std::vector<int> idx = order(self, iKey);
+    var r;
+    switch (atype())
+    {
+    case TYPE_CFLOAT:
+        r = copy(true);
+        gather(self.ptr<cfloat>(), idx, r.ptr<cfloat>());
+        break;
+    case TYPE_CDOUBLE:
+        r = copy(true);
+        gather(self.ptr<cdouble>(), idx, r.ptr<cdouble>());
+        break;
+    case TYPE_VAR:
+        r = copy(true);
+        gather(heap()->ptrvar(), idx, r.heap()->ptrvar());
+        break;
+    case TYPE_PAIR:
+        r.attach(new Heap(idx.size(), TYPE_VAR));
+        for (size_t i=0; i<idx.size(); i++)
+            r.heap()->ptrvar()[i] = heap()->ptrpair()[idx[i]].val;
+        break;
+    default:
+        throw error("var::sort(): Unknown type");
+    }
+    return r;
+}
+
+
+template<class T>
+static void row(T* iData, T* oData, int iSize)
+{
+    if (iData != oData)
+        std::copy(iData, iData + iSize, oData);
+    psort(oData, oData + iSize, std::less<T>());
+}
+
+
+/**
+ * Sorts along the last dimension.  Out of place, each row is copied and then
+ * sorted in place.
+ */
+void Sort::vector(var iVar, var& oVar) const
+{
+    int size = iVar.shape(-1);
+    switch (iVar.atype())
+    {
+    case TYPE_CHAR:
+        row(iVar.ptr<char>(), oVar.ptr<char>(), size);
+        break;
+    case TYPE_INT:
+        row(iVar.ptr<int>(), oVar.ptr<int>(), size);
+        break;
+    case TYPE_LONG:
+        row(iVar.ptr<long>(), oVar.ptr<long>(), size);
+        break;
+    case TYPE_FLOAT:
+        row(iVar.ptr<float>(), oVar.ptr<float>(), size);
+        break;
+    case TYPE_DOUBLE:
+        row(iVar.ptr<double>(), oVar.ptr<double>(), size);
+        break;
+    default:
+        // Sorting CFLOAT and CDOUBLE is undefined
+        throw error("Sort::vector: Unknown type");
+    }
+}
+
+
@@ -7,7 +7,12 @@
  *   Phil Garner, July 2016
  */
 
+#include <charconv>
+#include <cstring>
+#include <sstream>
+
 #include "var.h"
+#include "heap.h"
 
 using namespace libube;
 
@@ -95,3 +100,141 @@ varstream::varstream(class var iVar)
     // either didn't understand it or had problems before.
     //rdbuf(&mVarBuf);
 }
+
+
+/**
+ * Basic constructor
+ *
+ * As for varbuf, a defined var is appended to; otherwise a new string is
+ * started.
+ */
+strbuilder::strbuilder(class var iVar)
+{
+    if (iVar)
+        mVar = iVar.array();
+    else
+    {
+        mVar = "";
+        mVar.array();
+    }
+}
+
+
+/**
+ * Makes room for the string to reach iSize characters without re-allocation.
+ */
+strbuilder& strbuilder::reserve(int iSize)
+{
+    if (iSize > mVar.size())
+        mVar.presize(iSize);
+    return *this;
+}
+
+
+/**
+ * Extends the string by iSize characters, returning a pointer to the first
+ * new one.
+ */
+char* strbuilder::grow(int iSize)
+{
+    int s = mVar.size();
+    mVar.resize(s + iSize);
+    return mVar.heap()->ptrchar(s);
+}
+
+
+strbuilder& strbuilder::append(const char* iStr, int iSize)
+{
+    std::memcpy(grow(iSize), iStr, iSize);
+    return *this;
+}
+
+
+strbuilder& strbuilder::append(const char* iStr)
+{
+    return append(iStr, std::strlen(iStr));
+}
+
+
+strbuilder& strbuilder::append(char iChar)
+{
+    *grow(1) = iChar;
+    return *this;
+}
+
+
+/** Formats an integer of any width into oBuf, returning its end */
+template<class T>
+static char* digits(T iInt, char (&oBuf)[24])
+{
+    return std::to_chars(oBuf, oBuf + sizeof(oBuf), iInt).ptr;
+}
+
+
+strbuilder& strbuilder::append(long iLong)
+{
+    char buf[24];
+    return append(buf, digits(iLong, buf) - buf);
+}
+
+
+strbuilder& strbuilder::append(unsigned long iLong)
+{
+    char buf[24];
+    return append(buf, digits(iLong, buf) - buf);
+}
+
+
+strbuilder& strbuilder::append(long long iLong)
+{
+    char buf[24];
+    return append(buf, digits(iLong, buf) - buf);
+}
+
+
+strbuilder& strbuilder::append(unsigned long long iLong)
+{
+    char buf[24];
+    return append(buf, digits(iLong, buf) - buf);
+}
+
+
+/**
+ * Doubles are formatted in the shortest form that reads back exactly.
+ */
+strbuilder& strbuilder::append(double iDouble)
+{
+    char buf[32];
+    std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), iDouble);
+    return append(buf, r.ptr - buf);
+}
+
+
+/**
+ * Strings are appended as they are, and scalars are formatted.  Anything else
+ * is formatted as by operator<<().
+ */
+strbuilder& strbuilder::append(class var iVar)
+{
+    if (!iVar)
+        return *this;
+    if (iVar.atype<char>())
+        return iVar.heap()
+            ? append(iVar.str(), iVar.size())
+            : append(iVar.get<char>());
+    if (!iVar.heap())
+        switch (iVar.type())
+        {
+        case TYPE_INT:
+        case TYPE_LONG:
+            return append(iVar.get<long>());
+        case TYPE_FLOAT:
+        case TYPE_DOUBLE:
+            return append(iVar.get<double>());
+        default:
+            break;
+        }
+    std::ostringstream os;
+    os << iVar;
+    return append(os.str().c_str(), os.str().size());
+}
@@ -19,6 +19,7 @@
 #include "lube/string.h"
 #include "lube/regex.h"
 #include "lube/var.h"
+#include "lube/heap.h"
 
 
 namespace libube
@@ -205,24 +206,36 @@ var var::split(int iMax) const
     return r;
 }
 
+/**
+ * Joins the elements with iStr between each pair.  The length is computed
+ * first, so the result is allocated once and the strings copied in.  Elements
+ * that are not strings are formatted as by strbuilder.
+ */
 var var::join(const char* iStr) const
 {
     if (atype<char>())
         return *this;
 
-    var r = "";
-    var s = iStr;
-    for (int i=0; i<size(); i++)
+    // Arrays of vars are read directly rather than via references
+    int n = size();
+    const var* v = atype<var>() ? heap()->ptrvar() : 0;
+    int sep = std::strlen(iStr);
+    int len = sep * std::max(n-1, 0);
+    for (int i=0; i<n; i++)
     {
-        if (i == 0)
-            r.insert(at(0));
-        else
-        {
-            r.insert(s, r.size());
-            r.insert(at(i), r.size());
-        }
+        var e = v ? v[i] : at(i);
+        if (e.heap() && e.atype<char>())
+            len += e.size();
     }
 
+    strbuilder r;
+    r.reserve(len);
+    for (int i=0; i<n; i++)
+    {
+        if (i)
+            r.append(iStr, sep);
+        r.append(v ? v[i] : at(i));
+    }
     return r;
 }
 
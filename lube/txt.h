@@ -0,0 +1,44 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#ifndef TXT_H
+#define TXT_H
+
+#include <functional>
+#include <lube/module.h>
+
+namespace libube
+{
+    /**
+     * Virtual interface to the text file module
+     *
+     * Beyond the file interface, read() can take a function that is called on
+     * each line, e.g., to split it.  The result replaces the line.  If the
+     * module was created with a "threads" attribute, the function is called
+     * from worker threads, so it must not touch shared vars.
+     */
+    class txt : public file
+    {
+    public:
+        using file::read;
+        virtual var read(var iFile, std::function<var(var)> iLine) = 0;
+    };
+
+    /** Module specialised to read text files */
+    class txtmodule : public module
+    {
+    public:
+        txtmodule() : module("txt") {}
+        txt& create(var iArg=nil) {
+            return dynamic_cast<txt&>(module::create(iArg));
+        }
+    };
+};
+
+#endif // TXT_H
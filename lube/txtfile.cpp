@@ -7,22 +7,40 @@
  *   Phil Garner, October 2013
  */
 
+#include <cstring>
 #include <fstream>
 #include <stdexcept>
-#include <lube/module.h>
+#include <thread>
+#include <vector>
+#include <lube/txt.h>
+#include <lube/heap.h>
+#include <lube/lines.h>
 
 namespace libube
 {
-    class txtfile : public file
+    /**
+     * Text file handler
+     *
+     * Reads a file into an array of lines.  With a "threads" attribute the
+     * file is mapped and split into chunks that are read in parallel; zero or
+     * fewer threads means one per core.  The parallel result is always an
+     * array of var.
+     */
+    class txtfile : public txt
     {
     public:
+        txtfile(var iAttr) { mAttr = iAttr; };
         virtual var read(var iFile);
+        virtual var read(var iFile, std::function<var(var)> iLine);
         virtual void write(var iFile, var iVar);
+    private:
+        var mAttr;
+        var readChunks(var iFile, int iThreads, std::function<var(var)> iLine);
     };
 
     void factory(Module** oModule, var iArg)
     {
-        *oModule = new txtfile;
+        *oModule = new txtfile(iArg);
     }
 }
 
@@ -32,14 +50,118 @@ using namespace libube;
 
 var txtfile::read(var iFile)
 {
-    std::ifstream is(iFile.str(), std::ifstream::in);
-    if (is.fail())
-        throw error("txtfile::read(): Open failed");
+    return read(iFile, nullptr);
+}
+
+var txtfile::read(var iFile, std::function<var(var)> iLine)
+{
+    if (mAttr && mAttr.at("threads"))
+    {
+        int threads = mAttr.at("threads").cast<int>();
+        if (threads <= 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        return readChunks(iFile, threads, iLine);
+    }
+
+    // Each line is built straight from the read buffer
+    lines ls(iFile);
+    var o;
+    const char* line;
+    int size;
+    while (ls.next(line, size))
+        o.push(iLine ? iLine(var(size, line)) : var(size, line));
+    return o;
+}
+
+/**
+ * Read the lines of iData[iBeg,iEnd) into consecutive vars starting at oLines.
+ * Runs in a worker thread; the vars are distinct from those of other threads.
+ */
+static void readChunk(
+    const char* iData, long iBeg, long iEnd,
+    std::function<var(var)> iLine, var* oLines, std::exception_ptr* oError
+)
+{
+    try
+    {
+        const char* p = iData + iBeg;
+        const char* end = iData + iEnd;
+        while (p < end)
+        {
+            const char* nl = (const char*)std::memchr(p, '\n', end - p);
+            const char* eol = nl ? nl : end;
+            var l(eol - p, p);
+            *oLines++ = iLine ? iLine(l) : l;
+            p = eol + 1;
+        }
+    }
+    catch (...)
+    {
+        *oError = std::current_exception();
+    }
+}
+
+/**
+ * Parallel read.  The file is mapped and divided into one chunk per thread,
+ * each boundary moved to just after a newline.  Counting the newlines gives
+ * the size of the result and where each chunk's lines go, so the threads can
+ * write their lines directly into the one array.
+ */
+var txtfile::readChunks(var iFile, int iThreads, std::function<var(var)> iLine)
+{
+    mapped buf(iFile);
+    const char* data = buf.data();
+    long size = buf.size();
+    if (size == 0)
+        return nil;
+
+    // Chunk boundaries
+    std::vector<long> beg(iThreads+1);
+    beg[0] = 0;
+    for (int t=1; t<iThreads; t++)
+    {
+        long b = std::max(beg[t-1], size * t / iThreads);
+        const char* nl = (b > 0)
+            ? (const char*)std::memchr(data + b - 1, '\n', size - b + 1)
+            : data;
+        beg[t] = nl ? nl - data + (b > 0) : size;
+    }
+    beg[iThreads] = size;
+
+    // Index of the first line of each chunk; the last line may have no
+    // newline
+    std::vector<int> first(iThreads+1);
+    first[0] = 0;
+    for (int t=0; t<iThreads; t++)
+    {
+        int n = 0;
+        const char* p = data + beg[t];
+        const char* end = data + beg[t+1];
+        while ((p < end) && (p = (const char*)std::memchr(p, '\n', end - p)))
+        {
+            n++;
+            p++;
+        }
+        first[t+1] = first[t] + n;
+    }
+    if (data[size-1] != '\n')
+        first[iThreads]++;
 
+    // Read the chunks in parallel into the array of lines
     var o;
-    var f;
-    while (f.getline(is))
-        o.push(f.copy());
+    o.resize(first[iThreads]);
+    var* lines = o.heap()->ptrvar();
+    std::vector<std::exception_ptr> err(iThreads);
+    std::vector<std::thread> thread;
+    for (int t=0; t<iThreads; t++)
+        thread.emplace_back(
+            readChunk, data, beg[t], beg[t+1], iLine, lines + first[t], &err[t]
+        );
+    for (int t=0; t<iThreads; t++)
+        thread[t].join();
+    for (int t=0; t<iThreads; t++)
+        if (err[t])
+            std::rethrow_exception(err[t]);
     return o;
 }
 
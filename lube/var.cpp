@@ -30,6 +30,9 @@
 
 using namespace libube;
 
+// In heap.cpp
+int sizeOf(ind iType);
+
 
 #define GET(T, P)                                               \
     template<> T libube::var::get<T>() const                    \
@@ -183,6 +186,41 @@ PTR(cfloat)
 PTR(cdouble)
 
 
+/**
+ * Span accessor
+ *
+ * Unlike ptr<>(), this checks that the var is an array of the given type.
+ * The span covers the whole array, or the whole of a view.
+ */
+#define SPAN(T, E)                                                      \
+    template<> libube::span<T> libube::var::span<T>()                   \
+    {                                                                   \
+        IHeap* h = heap();                                              \
+        if (!h || (h->type() != E))                                     \
+            throw error("var::span(): not an array of " #T);            \
+        return libube::span<T>(h->ptr##T(), h->size());                 \
+    }
+
+SPAN(char, TYPE_CHAR)
+SPAN(int, TYPE_INT)
+SPAN(long, TYPE_LONG)
+SPAN(float, TYPE_FLOAT)
+SPAN(double, TYPE_DOUBLE)
+SPAN(cfloat, TYPE_CFLOAT)
+SPAN(cdouble, TYPE_CDOUBLE)
+SPAN(var, TYPE_VAR)
+SPAN(pair, TYPE_PAIR)
+
+
+/**
+ * The key:value pairs of a map, as a span
+ */
+libube::span<pair> var::items()
+{
+    return span<pair>();
+}
+
+
 /**
  * Get a string
  *
@@ -461,7 +499,7 @@ var::var(int iSize, var iVar) : var()
 
 var::var(const std::initializer_list<var> iList) : var()
 {
-    for (const var* it=begin(iList); it!=end(iList); ++it)
+    for (const var* it=std::begin(iList); it!=std::end(iList); ++it)
         push(*it);
 }
 
@@ -498,83 +536,6 @@ var& var::varderef()
 }
 
 
-/**
- * Negation operator
- *
- * It turns out that the negation is easier to code than the equality; i.e.,
- * there are lots of not equal cases where you just want to bail out as soon as
- * you know it's not equal.  So the equality operator calls "not this".
- */
-bool var::operator !=(var iVar) const
-{
-    if (type() != iVar.type())
-        return true;
-    if (size() != iVar.size())
-        return true;
-    switch (type())
-    {
-    case TYPE_ARRAY:
-        return heap()->neq(iVar.heap());
-    case TYPE_CHAR:
-        return (get<char>() != iVar.get<char>());
-    case TYPE_INT:
-        return (get<int>() != iVar.get<int>());
-    case TYPE_LONG:
-        return (get<long>() != iVar.get<long>());
-    case TYPE_FLOAT:
-        return (get<float>() != iVar.get<float>());
-    case TYPE_DOUBLE:
-        return (get<double>() != iVar.get<double>());
-    case TYPE_CFLOAT:
-        return (get<cfloat>() != iVar.get<cfloat>());
-    case TYPE_CDOUBLE:
-        return (get<cdouble>() != iVar.get<cdouble>());
-    default:
-        throw error("operator !=(): Unknown type");
-    }
-
-    assert(0);
-    return false;
-}
-
-
-/*
- * Operator <
- *
- * This is the one that gets used by std::map in its search.
- */
-bool var::operator <(var iVar) const
-{
-    if (type() != iVar.type())
-        return (type() < iVar.type());
-
-    switch (type())
-    {
-    case TYPE_ARRAY:
-        return heap()->lt(iVar.heap());
-    case TYPE_CHAR:
-        return (get<char>() < iVar.get<char>());
-    case TYPE_INT:
-        return (get<int>() < iVar.get<int>());
-    case TYPE_LONG:
-        return (get<long>() < iVar.get<long>());
-    case TYPE_FLOAT:
-        return (get<float>() < iVar.get<float>());
-    case TYPE_DOUBLE:
-        return (get<double>() < iVar.get<double>());
-    case TYPE_CFLOAT:
-        return (std::abs(get<cfloat>()) < std::abs(iVar.get<cfloat>()));
-    case TYPE_CDOUBLE:
-        return (std::abs(get<cdouble>()) < std::abs(iVar.get<cdouble>()));
-    default:
-        throw error("operator <(): Unknown type");
-    }
-
-    assert(0);
-    return false;
-}
-
-
 /**
  * Shallow copy
  *
@@ -746,8 +707,9 @@ var var::operator [](var iVar)
             return operator [](iVar.cast<int>());
     if (!iVar)
         return nil;
-    int index = v.binary(iVar);
-    if ( (index >= v.size()) || (v.heap()->key(index) != iVar) )
+    bool found;
+    int index = v.binary(iVar, &found);
+    if (!found)
         v.insert(iVar, index);
     return v.reference(index);
 }
@@ -834,10 +796,15 @@ var var::at(var iVar) const
         if (heap() && !atype<pair>())
             throw error("operator [var]: Not a map");
 
-    int index = binary(iVar);
-    if ( (index >= size()) || (heap()->key(index) != iVar) )
+    // As for at(int), a reference must be dereferenced to index the map
+    // rather than the array holding it
+    var v = *this;
+    v.dereference();
+    bool found;
+    int index = v.binary(iVar, &found);
+    if (!found)
         return nil;
-    return reference(index);
+    return v.reference(index);
 }
 
 
@@ -1098,33 +1065,46 @@ var var::pop()
 
 
 /**
- * Insert.  Not a fundamentally efficient thing for an array, and not
- * implemented in an efficient way.
+ * Insert.  Not a fundamentally efficient thing for an array, but the
+ * elements above iIndex are at least moved up as one block.
  */
+/**
+ * iVar, copied if its storage is iHeap or a view of it.  Moving the elements
+ * of iHeap would otherwise move the data being inserted, as in s.append(s).
+ */
+static var unshare(var iVar, IHeap* iHeap)
+{
+    IHeap* h = iVar.heap();
+    if (h && ((h == iHeap) || (h->view() == iHeap)))
+        return iVar.copy();
+    return iVar;
+}
+
+
 var& var::insert(var iVar, int iIndex)
 {
     if (iIndex > size())
         throw std::range_error("insert(): index too large");
 
-    if (heap() && atype<var>())
+    IHeap* h = heap();
+    if (h && atype<var>())
     {
         // Implies array; insert a single var
-        resize(size()+1);
-        for (int i=size()-1; i>iIndex; i--)
-            at(i) = at(i-1);
-        at(iIndex) = iVar;
+        h->insert(iIndex, 1);
+        *h->ptrvar(iIndex) = iVar;
     }
-    else if (heap() && atype<pair>())
+    else if (h && atype<pair>())
     {
         // Implies array; insert a single pair
-        resize(size()+1);
-        for (int i=size()-1; i>iIndex; i--)
-        {
-            heap()->key(i) = heap()->key(i-1);
-            at(i) = at(i-1);
-        }
-        heap()->key(iIndex) = iVar;
-        at(iIndex).clear();
+        h->insert(iIndex, 1);
+        h->key(iIndex) = iVar;
+    }
+    else if (h && !view())
+    {
+        // It's a fundamental type, insert the whole array
+        iVar = unshare(iVar, h);
+        h->insert(iIndex, iVar.size());
+        fill(iIndex, iVar);
     }
     else
     {
@@ -1147,70 +1127,144 @@ var var::remove(int iIndex)
         throw std::range_error("remove(): index too large");
 
     var r = at(iIndex).copy();
-    for (int i=iIndex+1; i<size(); i++)
-        at(i-1) = at(i);
-    resize(size()-1);
+    if (heap())
+        heap()->remove(iIndex, 1);
+    else
+        resize(size()-1);
     return r;
 }
 
 
-var var::shift()
+/**
+ * Copies iVar into the elements from iIndex of a dense array; a block copy
+ * if the types match, otherwise element by element.
+ */
+void var::fill(int iIndex, var iVar)
 {
-    if (heap())
-        return heap()->shift();
+    if (iVar.heap() && (iVar.atype() == atype()) && !iVar.view())
+    {
+        int s = sizeOf(atype());
+        std::memcpy(
+            heap()->ptrchar() + iIndex*s, iVar.heap()->ptrchar(),
+            iVar.size()*s
+        );
+    }
     else
-        return *this;
+        for (int i=0; i<iVar.size(); i++)
+            at(iIndex+i) = iVar.at(i);
 }
 
 
-var& var::unshift(var iVar)
-{
-    if (!defined())
+/**
+ * Removes and returns iSize elements from iIndex, as an array of the same
+ * type.  If iVar is defined, it is inserted in their place: its elements in
+ * the case of an array of vars, otherwise as for insert().  The elements
+ * above move as one block.
+ */
+var var::splice(int iIndex, int iSize, var iVar)
+{
+    IHeap* h = heap();
+    if (!h || view())
+        throw error("splice(): not an array");
+    if ((iIndex < 0) || (iSize < 0) || (iIndex+iSize > size()))
+        throw std::range_error("splice(): index out of range");
+    if (iVar && atype<pair>())
+        throw error("splice(): can't insert into a map");
+
+    var r = slice(iIndex, iIndex+iSize);
+    iVar = unshare(iVar, h);
+    int n = 0;
+    if (iVar)
+        n = (atype<var>() && !(iVar.heap() && iVar.atype<var>()))
+            ? 1 : iVar.size();
+
+    // Open or close the difference, then overwrite in place
+    if (n > iSize)
+        h->insert(iIndex+iSize, n-iSize);
+    else if (n < iSize)
+        h->remove(iIndex+n, iSize-n);
+    if (!n)
+        return r;
+    if (atype<var>())
     {
-        *this = iVar;
-        return *this;
+        var* dst = h->ptrvar(iIndex);
+        if (n == 1 && !(iVar.heap() && iVar.atype<var>()))
+            dst[0] = iVar;
+        else
+            for (int i=0; i<n; i++)
+                dst[i] = iVar.at(i);
     }
-
-    if (!heap())
-        array();
-    heap()->unshift(iVar);
-    return *this;
+    else
+        fill(iIndex, iVar);
+    return r;
 }
 
 
-var var::sort() const
+/**
+ * Removes iSize elements from iIndex, returning them as an array.
+ */
+var var::remove(int iIndex, int iSize)
 {
+    return splice(iIndex, iSize);
+}
+
+
+/**
+ * Returns a copy of the elements from iBegin up to but not including iEnd,
+ * as an array of the same type; for a map, the pairs in that range.
+ */
+var var::slice(int iBegin, int iEnd) const
+{
+    IHeap* h = heap();
+    if (!h)
+        throw error("slice(): not an array");
+    if ((iBegin < 0) || (iEnd < iBegin) || (iEnd > size()))
+        throw std::range_error("slice(): index out of range");
+    int n = iEnd - iBegin;
     var r;
-    r.presize(size());
-    for (int i=0; i<size(); i++)
+    r.attach(new Heap(n, atype()));
+    IHeap* rh = r.heap();
+    switch (atype())
     {
-        int p = r.binary(at(i));
-        r.insert(at(i), p);
+    case TYPE_VAR:
+        for (int i=0; i<n; i++)
+            *rh->ptrvar(i) = *h->ptrvar(iBegin+i);
+        break;
+    case TYPE_PAIR:
+        for (int i=0; i<n; i++)
+            *rh->ptrpair(i) = *h->ptrpair(iBegin+i);
+        break;
+    default:
+    {
+        int s = sizeOf(atype());
+        std::memcpy(rh->ptrchar(), h->ptrchar() + iBegin*s, n*s);
+    }
     }
     return r;
 }
 
 
-ind var::index(var iVar) const
+var var::shift()
+{
+    if (heap())
+        return heap()->shift();
+    else
+        return *this;
+}
+
+
+var& var::unshift(var iVar)
 {
-    int index;
     if (!defined())
-        return -1;
-    switch (atype())
     {
-    case TYPE_PAIR:
-        // Pairs are sorted
-        index = binary(iVar);
-        if ( (index < size()) && (heap()->key(index) == iVar) )
-            return index;
-        break;
-    default:
-        // Nothing else is sorted; start at the beginning
-        for (ind i=0; i<size(); i++)
-            if (at(i) == iVar)
-                return i;
+        *this = iVar;
+        return *this;
     }
-    return -1;
+
+    if (!heap())
+        array();
+    heap()->unshift(iVar);
+    return *this;
 }
 
 
@@ -1323,31 +1377,6 @@ var& var::dereference()
 }
 
 
-/**
- * Binary search
- */
-int var::binary(var iData) const
-{
-    if (size() == 0)
-        return 0;
-
-    int lo = 0;
-    int hi = size();
-    bool p =  // index on key rather than value
-        (heap() && this->atype<pair>());
-    while (lo != hi)
-    {
-        int pos = (hi-lo)/2 + lo;
-        var x = p ? heap()->key(pos) : at(pos);
-        if (x < iData)
-            lo = pos+1;
-        else
-            hi = pos;
-    }
-    return hi;
-}
-
-
 /**
  * Assuming that *this is an array, returns a view of the array.  A view is
  * just another array, of type int, holding the dimensions of the new view.
@@ -1383,7 +1412,7 @@ var var::view(var iShape, int iOffset)
 var libube::view(const std::initializer_list<int> iShape, var iType)
 {
     int s = 1;
-    for (const int* it=begin(iShape); it!=end(iShape); ++it)
+    for (const int* it=std::begin(iShape); it!=std::end(iShape); ++it)
         s *= *it;
     var v = iType ? iType : 0.0f;
     v.array();
@@ -10,10 +10,13 @@
 #ifndef VAR_H
 #define VAR_H
 
+#include <cassert>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
 #include <initializer_list>
 #include <chrono>
+#include <functional>
 
 #include <lube/ind.h>
 #include <lube/func.h>
@@ -56,6 +59,44 @@ namespace libube
     extern Cast<cdouble> castCDouble;
 
 
+    struct pair;
+
+    /**
+     * A non-owning range of contiguous elements
+     *
+     * As returned by var::span(), it is just a pointer and a size, so access
+     * and iteration cost no reference counting or virtual calls; a loop over
+     * one is a loop over a C array.  It doesn't keep the array alive, and is
+     * invalidated by anything that resizes the array.  at() is bounds
+     * checked; operator[]() asserts.  The iterators are plain pointers, so
+     * std algorithms, including the parallel ones, work in place.
+     */
+    template<class T>
+    class span
+    {
+    public:
+        typedef T value_type;
+        typedef T* iterator;
+        span(T* iData=0, int iSize=0) : mData(iData), mSize(iSize) {};
+        T* begin() const { return mData; };
+        T* end() const { return mData + mSize; };
+        T* data() const { return mData; };
+        int size() const { return mSize; };
+        T& operator [](int iIndex) const {
+            assert((iIndex >= 0) && (iIndex < mSize));
+            return mData[iIndex];
+        };
+        T& at(int iIndex) const {
+            if ((iIndex < 0) || (iIndex >= mSize))
+                throw std::range_error("span::at(): index out of bounds");
+            return mData[iIndex];
+        };
+    private:
+        T* mData;
+        int mSize;
+    };
+
+
     /**
      * Class with runtime type determination.
      *
@@ -93,8 +134,15 @@ namespace libube
         // Data accessor
         template<class T> T get() const;
         template<class T> T* ptr(ind iIndex=0);
+        template<class T> libube::span<T> span();
+        libube::span<pair> items();
         const char* str() const;
 
+        // Iteration
+        class iterator;
+        iterator begin() const;
+        iterator end() const;
+
         // Operators
         bool operator !=(var iVar) const;
         bool operator <(var iVar) const;
@@ -102,6 +150,7 @@ namespace libube
         bool operator >(var iVar) const { return iVar < *this; };
         bool operator <=(var iVar) const { return !(*this > iVar); };
         bool operator >=(var iVar) const { return !(*this < iVar); };
+        int compare(var iVar) const;
         var& operator +=(var iVar) { add(*this, iVar, *this); return *this; };
         var& operator -=(var iVar) { sub(*this, iVar, *this); return *this; };
         var& operator *=(var iVar) { mul(*this, iVar, *this); return *this; };
@@ -127,6 +176,7 @@ namespace libube
         var at(var iVar) const;
         var key(int iIndex) const;
         var copy(bool iAllocOnly=false) const;
+        size_t hash() const;
         bool defined() const;
         int size() const;
         ind type() const;
@@ -139,13 +189,21 @@ namespace libube
         var& push(var iVar);
         var& insert(var iVar, int iIndex=0);
         var remove(int iIndex);
+        var remove(int iIndex, int iSize);
+        var splice(int iIndex, int iSize, var iVar=nil);
+        var slice(int iBegin, int iEnd) const;
         var& unshift(var iVar);
         var& append(var iVar) { return insert(iVar, size()); };
         var& append(const char* iStr);
         template<class T> var& append(int iSize, const T* iData);
         var shift();
-        var sort() const;
+        var sort(var iKey=nil) const;
+        var argsort(var iKey=nil) const;
         ind index(var iVar) const;
+        var indices(var iVar) const;
+        int count(var iVar) const;
+        bool contains(var iVar) const { return index(iVar) >= 0; };
+        var isin(var iVar) const;
         var& clear();
         var& array();
         var& resize(int iSize);
@@ -198,6 +256,7 @@ namespace libube
         int dim() const;
 
     private:
+        friend var mapfile(var iFile, var iType, long iOffset, int iSize);
 
         union dataType {
             dataType() { hp = 0; }; // Because of cfloat
@@ -222,7 +281,62 @@ namespace libube
         var reference(int iIndex) const;
         int attach(IHeap* iHeap=0);
         int detach(IHeap* iHeap=0);
-        int binary(var iData) const;
+        int binary(var iData, bool* oFound=0) const;
+        void fill(int iIndex, var iVar);
+    };
+
+
+    /**
+     * Iterator over the elements of a var
+     *
+     * Dereferencing gives at(), so the element of an array (the value, for a
+     * map) as a reference that can be assigned through.  As that is a var
+     * rather than a var&, this is an input iterator; algorithms that only
+     * read, such as find() or accumulate(), work on any type, but those that
+     * swap or move elements need span().  Each step builds a var, so for
+     * whole loops over the data span() is faster too, and items() gives the
+     * keys of a map.
+     */
+    class var::iterator
+    {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef var value_type;
+        typedef int difference_type;
+        typedef void pointer;
+        typedef var reference;
+
+        iterator(var iVar=nil, int iIndex=0)
+            : mVar(iVar), mHeap(iVar.heap()), mIndex(iIndex) {};
+        var operator *() const { return mVar.at(mIndex); };
+        int index() const { return mIndex; };
+        iterator& operator ++() { mIndex++; return *this; };
+        iterator operator ++(int) {
+            iterator r = *this;
+            mIndex++;
+            return r;
+        };
+        bool operator ==(const iterator& iIt) const {
+            return (mHeap == iIt.mHeap) && (mIndex == iIt.mIndex);
+        };
+        bool operator !=(const iterator& iIt) const {
+            return !(*this == iIt);
+        };
+    private:
+        var mVar;
+        IHeap* mHeap;   ///< Identifies the array
+        int mIndex;
+    };
+
+    inline var::iterator var::begin() const { return iterator(*this, 0); };
+    inline var::iterator var::end() const { return iterator(*this, size()); };
+
+
+    /** Two vars; the element type of a map */
+    struct pair
+    {
+        var key;
+        var val;
     };
 
 
@@ -231,14 +345,20 @@ namespace libube
      */
     std::ostream& operator <<(std::ostream& iStream, var iVar);
     std::istream& operator >>(std::istream& iStream, var& ioVar);
+    std::istream& internkeys(std::istream& iStream);
     var view(const std::initializer_list<int> iShape, var iType=nil);
     var view(var iShape, var iType=nil);
+    var mapfile(var iFile, var iType=nil, long iOffset=0, int iSize=-1);
     const char* typeStr(ind iType);
     var range(var iLo, var iHi, var iStep=1);
     var range(var iHi);
     var irange(var iLo, var iHi, var iStep=1);
     var irange(var iHi);
 
+    // Interned strings share storage with a per-thread table, so results
+    // holding them must not be handed to other threads
+    var intern(var iStr);
+
 
     /**
      * A stream buffer to connect a stream to a var
@@ -276,6 +396,43 @@ namespace libube
     };
 
 
+    /**
+     * A string builder
+     *
+     * Appends to the end of a char array, which grows geometrically, so
+     * building a string of N characters is O(N).  Numbers are formatted
+     * with std::to_chars rather than going through a stream.  As for
+     * varstream, a string passed to the constructor is appended to in place.
+     */
+    class strbuilder
+    {
+    public:
+        strbuilder(var iVar = nil);
+        operator var() const { return mVar; };
+        const char* str() const { return mVar.str(); };
+        int size() const { return mVar.size(); };
+        strbuilder& reserve(int iSize);
+        strbuilder& append(const char* iStr, int iSize);
+        strbuilder& append(const char* iStr);
+        strbuilder& append(char iChar);
+        strbuilder& append(int iInt) { return append((long)iInt); };
+        strbuilder& append(unsigned iInt) {
+            return append((unsigned long)iInt);
+        };
+        strbuilder& append(long iLong);
+        strbuilder& append(unsigned long iLong);
+        strbuilder& append(long long iLong);
+        strbuilder& append(unsigned long long iLong);
+        strbuilder& append(double iDouble);
+        strbuilder& append(var iVar);
+        template<class T>
+        strbuilder& operator <<(T iVal) { return append(iVal); };
+    private:
+        var mVar; ///< The string being built
+        char* grow(int iSize);
+    };
+
+
     /**
      * Exception class
      */
@@ -306,4 +463,16 @@ namespace libube
 
 }
 
+namespace std
+{
+    /** Allows vars as keys of the unordered containers */
+    template<>
+    struct hash<libube::var>
+    {
+        size_t operator ()(const libube::var& iVar) const {
+            return iVar.hash();
+        };
+    };
+}
+
 #endif // VAR_H
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2026 by Philip N. Garner
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2026
+ */
+
+#ifndef XML_H
+#define XML_H
+
+#include <functional>
+#include <lube/module.h>
+
+namespace libube
+{
+    /**
+     * Virtual interface to the XML file module
+     *
+     * Beyond the file interface, read() can stream the elements with a given
+     * name.  Each matching element is built, passed to iElement, and then
+     * forgotten; nothing outside a matching element is built.  Matches
+     * nested inside a match are just part of the outer one.
+     *
+     * Likewise, a file can be written incrementally: open() it, then start()
+     * and end() elements, with text() or whole element()s in between.
+     * close() ends any elements still open.
+     *
+     * With an "intern" attribute, element and attribute names are interned,
+     * so each distinct name is stored once.  The result then shares storage
+     * with the reading thread's intern table, so must stay in that thread.
+     */
+    class xml : public file
+    {
+    public:
+        using file::read;
+        virtual void read(
+            var iFile, var iName, std::function<void(var)> iElement
+        ) = 0;
+        virtual void open(var iFile) = 0;
+        virtual void start(var iName, var iAttr=nil) = 0;
+        virtual void text(var iText) = 0;
+        virtual void element(var iElement) = 0;
+        virtual void end() = 0;
+        virtual void close() = 0;
+    };
+
+    /** Module specialised to read and write XML files */
+    class xmlmodule : public module
+    {
+    public:
+        xmlmodule() : module("xml") {}
+        xml& create(var iArg=nil) {
+            return dynamic_cast<xml&>(module::create(iArg));
+        }
+    };
+};
+
+#endif // XML_H
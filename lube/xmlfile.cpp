@@ -7,9 +7,13 @@
  *   Phil Garner, October 2013
  */
 
+#include <cctype>
+#include <cstring>
 #include <fstream>
 #include <stdexcept>
-#include <lube/module.h>
+#include <string>
+#include <vector>
+#include <lube/xml.h>
 #include <lube/data.h>
 
 #include <expat.h>
@@ -17,24 +21,76 @@
 
 namespace libube
 {
+    /**
+     * XML writer class
+     *
+     * Output is gathered in a buffer that is written out when it fills, and
+     * text is escaped a run of plain characters at a time.
+     */
+    class XMLWriter
+    {
+    public:
+        XMLWriter();
+        ~XMLWriter();
+        void write(const char* iFile, var iVar);
+        void open(const char* iFile);
+        void start(var iName, var iAttr);
+        void text(var iText);
+        void element(var iElem);
+        void end();
+        void close();
+    private:
+        std::ofstream mOS;                ///< The file
+        std::string mBuf;                 ///< Output buffer
+        std::vector<std::string> mOpen;   ///< Names of open elements
+        void put(const char* iStr, size_t iSize);
+        void put(const char* iStr) { put(iStr, std::strlen(iStr)); };
+        void flush();
+        void attributes(var iAttr);
+        bool writeElem(var iVar);
+        void escape(var iVar);
+    };
+
+
     /**
      * The main file handler class
      */
-    class XMLFile : public file
+    class XMLFile : public xml
     {
     public:
+        XMLFile(var iAttr) { mAttr = iAttr; };
         virtual var read(var iFile);
+        virtual void read(
+            var iFile, var iName, std::function<void(var)> iElement
+        );
         virtual void write(var iFile, var iVar);
+        virtual void open(var iFile);
+        virtual void start(var iName, var iAttr=nil);
+        virtual void text(var iText);
+        virtual void element(var iElement);
+        virtual void end();
+        virtual void close();
+    private:
+        XMLWriter mWriter;
+        var mAttr;
+        bool interning() { return mAttr && mAttr.at("intern"); };
     };
 
 
     /**
      * Class to wrap the expat library and callbacks.
+     *
+     * Given a name and a callback, only elements of that name (and their
+     * contents) are built, and each is passed to the callback when complete.
+     * mSkip counts the open elements that are not being built.
      */
     class Expat
     {
     public:
-        Expat();
+        Expat(
+            bool iIntern, var iName=nil,
+            std::function<void(var)> iElement=nullptr
+        );
         ~Expat();
         var parse(const char* iFile);
         void startElementHandler(const XML_Char *iName, const XML_Char **iAtts);
@@ -44,24 +100,18 @@ namespace libube
         var mVar;            ///< Var to populate during parse
         var mStack;          ///< Parse stack
         XML_Parser mParser;  ///< The expat parser
+        std::string mText;   ///< Character data not yet stored
+        var mName;           ///< Name of elements to stream
+        std::function<void(var)> mElement;  ///< Callback for streaming
+        int mSkip;           ///< Depth of unbuilt elements
+        bool mIntern;        ///< Whether to intern names
         var element();
-    };
-
-    /**
-     * XML writer class
-     */
-    class XMLWriter
-    {
-    public:
-        void write(const char* iFile, var iVar);
-    private:
-        bool writeElem(std::ofstream& iOS, var iVar);
-        void escape(std::ofstream& iOS, var iVar);
+        void text();
     };
 
     void factory(Module** oModule, var iArg)
     {
-        *oModule = new XMLFile;
+        *oModule = new XMLFile(iArg);
     }
 }
 
@@ -72,15 +122,49 @@ using namespace libube;
 var XMLFile::read(var iFile)
 {
     // Instantiate an expat class and use it to parse the file
-    Expat expat;
+    Expat expat(interning());
     return expat.parse(iFile.str());
 }
 
+void XMLFile::read(var iFile, var iName, std::function<void(var)> iElement)
+{
+    Expat expat(interning(), iName, iElement);
+    expat.parse(iFile.str());
+}
+
 void XMLFile::write(var iFile, var iVar)
 {
-    // Instantiate an XML writer and write the file
-    XMLWriter writer;
-    writer.write(iFile.str(), iVar);
+    mWriter.write(iFile.str(), iVar);
+}
+
+void XMLFile::open(var iFile)
+{
+    mWriter.open(iFile.str());
+}
+
+void XMLFile::start(var iName, var iAttr)
+{
+    mWriter.start(iName, iAttr);
+}
+
+void XMLFile::text(var iText)
+{
+    mWriter.text(iText);
+}
+
+void XMLFile::element(var iElement)
+{
+    mWriter.element(iElement);
+}
+
+void XMLFile::end()
+{
+    mWriter.end();
+}
+
+void XMLFile::close()
+{
+    mWriter.close();
 }
 
 
@@ -92,8 +176,11 @@ static void DefaultHandler(
     void *iUserData, const XML_Char *iStr, int iLen
 )
 {
-    // DOS line ends find their way here.  Why?
-    if ((iLen == 1) && (*iStr == '\r'))
+    // White space outside the root element finds its way here
+    int i = 0;
+    while ((i < iLen) && std::isspace((unsigned char)iStr[i]))
+        i++;
+    if (i == iLen)
         return;
 
     var str(iLen, iStr);
@@ -146,8 +233,13 @@ static void CharacterDataHandler(
  * those functions convert the UserData field into the class pointer
  * and pass the callback to the appropriate method.
  */
-Expat::Expat()
+Expat::Expat(bool iIntern, var iName, std::function<void(var)> iElement)
 {
+    mName = iName;
+    mElement = iElement;
+    mSkip = 0;
+    mIntern = iIntern;
+
     // Create the parser
     mParser = XML_ParserCreate(0);
 
@@ -167,24 +259,35 @@ Expat::~Expat()
 }
 
 
+/**
+ * Reads the file in large blocks straight into expat's own buffer.
+ */
 var Expat::parse(const char* iFile)
 {
-    std::ifstream is(iFile, std::ifstream::in);
+    std::ifstream is(iFile, std::ifstream::in | std::ifstream::binary);
     if (is.fail())
         throw error("xmlfile::read(): Open failed");
 
-    var f;
-    XML_Status s;
-    while (f.getline(is))
+    const int block = 1 << 16;
+    int n;
+    do
     {
-        s = XML_Parse(mParser, f.str(), f.size(), 0);
-        if (!s)
-            throw error("xmlfile::parse(): Error!");
+        void* buf = XML_GetBuffer(mParser, block);
+        if (!buf)
+            throw error("xmlfile::parse(): Out of memory");
+        is.read((char*)buf, block);
+        n = is.gcount();
+        if (!XML_ParseBuffer(mParser, n, n == 0))
+        {
+            varstream s;
+            s << "xmlfile::parse(): "
+              << XML_ErrorString(XML_GetErrorCode(mParser))
+              << " at line " << XML_GetCurrentLineNumber(mParser);
+            throw error(s);
+        }
     }
-    s = XML_Parse(mParser, f.str(), 0, 0);
-    if (!s)
-        throw error("xmlfile::parse(): Error!");
-    if (mStack.size() != 0)
+    while (n > 0);
+    if ((mStack.size() != 0) || (mSkip != 0))
         throw error("xmlfile::parse(): Short file?");
 
     return mVar;
@@ -206,18 +309,44 @@ var Expat::element()
 }
 
 
+/**
+ * Stores any pending character data.  Expat can deliver a single run of text
+ * in several pieces; they are gathered here so each run is a single var.
+ */
+void Expat::text()
+{
+    if (mText.empty())
+        return;
+    mStack.top()[DATA].push(var(mText.size(), mText.data()));
+    mText.clear();
+}
+
+
 void Expat::startElementHandler(const XML_Char *iName, const XML_Char **iAtts)
 {
+    // When streaming, skip anything outside a matching element
+    bool top = (mStack.size() == 0);
+    if (mName && top && (mName != iName))
+    {
+        mSkip++;
+        return;
+    }
+    if (!top)
+        text();
+
     var elem = element();
-    if (mStack)
+    if (!top)
         mStack.top()[DATA].push(elem);
     else
         mVar = elem;
     mStack.push(elem);
-    elem[NAME] = iName;
+    elem[NAME] = mIntern ? intern(iName) : var(iName);
     while (*iAtts)
     {
-        elem[ATTR][iAtts[0]] = iAtts[1];
+        if (mIntern)
+            elem[ATTR][intern(iAtts[0])] = iAtts[1];
+        else
+            elem[ATTR][iAtts[0]] = iAtts[1];
         iAtts += 2;
     }
 }
@@ -225,36 +354,136 @@ void Expat::startElementHandler(const XML_Char *iName, const XML_Char **iAtts)
 
 void Expat::endElementHandler(const XML_Char *iName)
 {
+    if (mStack.size() == 0)
+    {
+        mSkip--;
+        return;
+    }
+    text();
     if (mStack.top()[NAME] != iName)
         throw error("Expat::endElementHandler: malformed xml");
     mStack.pop();
+    if (mElement && (mStack.size() == 0))
+    {
+        mElement(mVar);
+        mVar = nil;
+    }
 }
 
 
 void Expat::characterDataHandler(const XML_Char *iStr, int iLen)
 {
-    var str(iLen, iStr);
-    mStack.top()[DATA].push(str);
+    if (mStack.size() > 0)
+        mText.append(iStr, iLen);
 }
 
 
-void XMLWriter::write(const char* iFile, var iVar)
+/** Size at which the output buffer is written out */
+const size_t BUFFER = 1 << 16;
+
+XMLWriter::XMLWriter()
 {
-    // Output stream
-    std::ofstream os(iFile, std::ofstream::out);
-    if (os.fail())
+    mBuf.reserve(BUFFER + 1024);
+}
+
+XMLWriter::~XMLWriter()
+{
+    // Don't throw from here
+    if (mOS.is_open())
+        mOS.write(mBuf.data(), mBuf.size());
+}
+
+void XMLWriter::put(const char* iStr, size_t iSize)
+{
+    mBuf.append(iStr, iSize);
+    if (mBuf.size() >= BUFFER)
+        flush();
+}
+
+void XMLWriter::flush()
+{
+    mOS.write(mBuf.data(), mBuf.size());
+    mBuf.clear();
+    if (mOS.fail())
+        throw error("xmlwriter::flush(): Write failed");
+}
+
+void XMLWriter::open(const char* iFile)
+{
+    if (mOS.is_open())
+        close();
+    mOS.open(iFile, std::ofstream::out | std::ofstream::binary);
+    if (mOS.fail())
         throw error("xmlwriter::write(): Open failed");
 
     // XML declaration
-    os << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << std::endl;
+    put("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+}
 
-    // Loop over iVar
-    if (!writeElem(os, iVar))
+void XMLWriter::close()
+{
+    if (!mOS.is_open())
+        return;
+    while (!mOpen.empty())
+        end();
+    put("\n");
+    flush();
+    mOS.close();
+}
+
+void XMLWriter::write(const char* iFile, var iVar)
+{
+    open(iFile);
+    if (!writeElem(iVar))
         throw error("xmlwriter::write(): Top level not element");
-    os << std::endl;
+    close();
 }
 
-bool XMLWriter::writeElem(std::ofstream& iOS, var iVar)
+void XMLWriter::start(var iName, var iAttr)
+{
+    put("<");
+    put(iName.str(), iName.size());
+    attributes(iAttr);
+    put(">");
+    mOpen.push_back(iName.str());
+}
+
+void XMLWriter::text(var iText)
+{
+    escape(iText);
+}
+
+void XMLWriter::element(var iElem)
+{
+    if (!writeElem(iElem))
+        throw error("xmlwriter::element(): Not an element");
+}
+
+void XMLWriter::end()
+{
+    if (mOpen.empty())
+        throw error("xmlwriter::end(): No element to end");
+    put("</");
+    put(mOpen.back().data(), mOpen.back().size());
+    put(">");
+    mOpen.pop_back();
+}
+
+void XMLWriter::attributes(var iAttr)
+{
+    if (iAttr)
+        for (int i=0; i<iAttr.size(); i++)
+        {
+            var key = iAttr.key(i);
+            put(" ");
+            put(key.str(), key.size());
+            put("=\"");
+            escape(iAttr[i]);
+            put("\"");
+        }
+}
+
+bool XMLWriter::writeElem(var iVar)
 {
     // Exit if it's not an element
     if ((iVar.size() != 4) || (iVar[TYPE] != "text"))
@@ -264,50 +493,52 @@ bool XMLWriter::writeElem(std::ofstream& iOS, var iVar)
     var name = iVar[NAME];
     var attr = iVar[ATTR];
     var data = iVar[DATA];
-    iOS << "<" << name.str();
-    if (attr)
-        for (int i=0; i<attr.size(); i++)
-        {
-            iOS << " " << attr.key(i).str() << "=\"";
-            escape(iOS, attr[i]);
-            iOS << "\"";
-        }
+    put("<");
+    put(name.str(), name.size());
+    attributes(attr);
     if (!data)
     {
-        iOS << " />";
+        put(" />");
         return true;
     }
-    iOS << ">";
+    put(">");
     for (int i=0; i<data.size(); i++)
-        if (!writeElem(iOS, data[i]))
-            escape(iOS, data[i]);
-    iOS << "</" << name.str() << ">";
+        if (!writeElem(data[i]))
+            escape(data[i]);
+    put("</");
+    put(name.str(), name.size());
+    put(">");
     return true;
 }
 
-void XMLWriter::escape(std::ofstream& iOS, var iVar)
+/**
+ * The entity for each character that needs escaping, zero otherwise.
+ */
+static const char* const* entities()
+{
+    static const char* table[256] = {};
+    table[(unsigned char)'&'] = "&amp;";
+    table[(unsigned char)'<'] = "&lt;";
+    table[(unsigned char)'>'] = "&gt;";
+    table[(unsigned char)'\''] = "&apos;";
+    table[(unsigned char)'"'] = "&quot;";
+    return table;
+}
+
+void XMLWriter::escape(var iVar)
 {
+    static const char* const* entity = entities();
     const char* str = iVar.str();
-    for (int i=0; i<iVar.size(); i++)
-        switch (str[i])
-        {
-        case '&':
-            iOS << "&amp;";
-            break;
-        case '<':
-            iOS << "&lt;";
-            break;
-        case '>':
-            iOS << "&gt;";
-            break;
-        case '\'':
-            iOS << "&apos;";
-            break;
-        case '"':
-            iOS << "&quot;";
-            break;
-        default:
-            iOS.put(str[i]);
-            break;
-        }
+    int size = iVar.size();
+    int i = 0;
+    while (i < size)
+    {
+        int run = i;
+        while ((run < size) && !entity[(unsigned char)str[run]])
+            run++;
+        put(str + i, run - i);
+        if (run < size)
+            put(entity[(unsigned char)str[run]]);
+        i = run + 1;
+    }
 }
@@ -1,6 +1,10 @@
 #include <fstream>
 
 #include "lube/lube.h"
+#include "lube/txt.h"
+#include "lube/snd.h"
+#include "lube/xml.h"
+#include "lube/data.h"
 
 using namespace std;
 using namespace lube;
@@ -20,17 +24,58 @@ int main(int argc, char** argv)
     }
     cout << t << endl;
 
+    // The same again with the block buffered reader
+    lube::lines ls(TEST_DIR "/test.txt");
+    var l;
+    while (ls.getline(l))
+        cout << l << endl;
+
     // Read the same text file via a dynamic library
     filemodule txtmod("txt");
     file& txtf = txtmod.create();
     var txt = txtf.read(TEST_DIR "/test.txt");
     cout << "Loaded: " << txt << endl;
 
+    // ...and in parallel, splitting each line
+    var txtAttr;
+    txtAttr["threads"] = 3;
+    lube::txtmodule ptxtmod;
+    lube::txt& ptxtf = ptxtmod.create(txtAttr);
+    var ptxt = ptxtf.read(TEST_DIR "/test.txt", [](var l){return l.split();});
+    cout << "Loaded: " << ptxt << endl;
+
+    // Libraries stay loaded, and can't be unloaded while in use
+    lube::module::preload("ini");
+    cout << "Unloaded txt: " << lube::module::unload("txt") << endl;
+    {
+        filemodule tmpmod("gnuplot");
+        tmpmod.create();
+    }
+    cout << "Unloaded gnuplot: " << lube::module::unload("gnuplot") << endl;
+
+    // A batch of files read ahead by a pool of workers
+    var batchAttr;
+    batchAttr["module"] = "txt";
+    batchAttr["threads"] = 2;
+    batchAttr["prefetch"] = 1;
+    var batchFiles;
+    batchFiles.push(TEST_DIR "/test.txt");
+    batchFiles.push(TEST_DIR "/test.ini");
+    batchFiles.push(TEST_DIR "/test.txt");
+    lube::batch txtBatch(batchFiles, batchAttr);
+    var lines;
+    while (txtBatch.next(lines))
+        cout << "Batch: " << lines.size() << " lines from " << lines[0] << endl;
+
     // Read a .ini file via a dynamic library
     filemodule inimod("ini");
     file& inif = inimod.create();
     var ini = inif.read(TEST_DIR "/test.ini");
     cout << "Loaded: " << ini << endl;
+    var iniAttr;
+    iniAttr["intern"] = 1;
+    file& inii = inimod.create(iniAttr);
+    cout << "Interned: " << (inii.read(TEST_DIR "/test.ini") == ini) << endl;
 
     // Init from comma separated list
     var ai;
@@ -57,6 +102,62 @@ int main(int argc, char** argv)
     var xml = xmlf.read(TEST_DIR "/test.xml");
     cout << "Loaded: " << xml << endl;
     xmlf.write("test-out.xml", xml);
+    lube::xmlmodule sxmlmod;
+    lube::xml& sxmlf = sxmlmod.create();
+    sxmlf.read(TEST_DIR "/test.xml", "element2", [](var e){
+        cout << "Streamed: " << e << endl;
+    });
+    var xmlAttr;
+    xmlAttr["n"] = "<1>";
+    sxmlf.open("test-out-stream.xml");
+    sxmlf.start("list");
+    sxmlf.start("item", xmlAttr);
+    sxmlf.text("a & b");
+    sxmlf.end();
+    sxmlf.element(xml[lube::DATA][1]);
+    sxmlf.close();
+    cout << "Written: " << sxmlf.read("test-out-stream.xml") << endl;
+
+    // NumPy; a view, a map of arrays as .npz, and a mapped read
+    var npyAttr;
+    npyAttr["mmap"] = 1;
+    filemodule npymod("npy");
+    file& npyf = npymod.create();
+    var npa = lube::range(0.0, 5.0).view({2, 3});
+    npyf.write("test-out.npy", npa);
+    cout << "Loaded: " << npyf.read("test-out.npy") << endl;
+    var npz;
+    npz["ints"] = lube::irange(4);
+    npz["floats"] = lube::range(1.0f, 6.0f).view({3, 2});
+    npyf.write("test-out.npz", npz);
+    cout << "Loaded: " << npyf.read("test-out.npz") << endl;
+    file& npymf = npymod.create(npyAttr);
+    cout << "Mapped: " << npymf.read("test-out.npz") << endl;
+
+    // Numeric CSV; write with a header, then read some columns by name in
+    // parallel
+    var csvAttr;
+    csvAttr["names"] = var("a,b,c").split(",");
+    filemodule csvmod("csv");
+    file& csvf = csvmod.create(csvAttr);
+    var csv = lube::range(0.0, 11.0).view({4, 3}) / 4.0;
+    csvf.write("test-out.csv", csv);
+    var csvrAttr;
+    csvrAttr["header"] = 1;
+    csvrAttr["columns"] = var("c,a").split(",");
+    csvrAttr["threads"] = 2;
+    csvrAttr["type"] = 0.0;
+    file& csvrf = csvmod.create(csvrAttr);
+    cout << "Loaded: " << csvrf.read("test-out.csv") << endl;
+
+    // Enough rows to span several write blocks
+    var big = lube::range(0.0, 30000.0).view({10000, 3}) / 7.0;
+    csvf.write("test-out.csv", big);
+    var bigAttr;
+    bigAttr["header"] = 1;
+    bigAttr["type"] = 0.0;
+    var back = csvmod.create(bigAttr).read("test-out.csv");
+    cout << "Round trip: " << back.shape() << " " << (back == big) << endl;
 
     // wav
     var sndAttr;
@@ -70,6 +171,25 @@ int main(int argc, char** argv)
     cout << " channels: " << (dim > 1 ? wav.shape(0) : 1) << endl;
     cout << " frames:   " << wav.shape(dim-1) << endl;
 
+    // wav again, streamed in blocks, then the end of it after a seek
+    lube::sndmodule sndmod;
+    lube::snd& sndf = sndmod.create(sndAttr);
+    sndf.open(TEST_DIR "/test.wav");
+    var block;
+    int got;
+    int blocks = 0;
+    int frames = 0;
+    while ((got = sndf.read(block, 16000)) > 0)
+    {
+        blocks++;
+        frames += got;
+    }
+    cout << " blocks:   " << blocks << " of " << block.size() << endl;
+    cout << " streamed: " << frames << endl;
+    cout << " seek:     " << sndf.seek(-1000, SEEK_END) << endl;
+    cout << " tail:     " << sndf.read(block, 16000) << endl;
+    sndf.close();
+
     // Done
     return 0;
 }
@@ -32,5 +32,50 @@ int main()
               << v3 << std::endl;
     g.writeGraphViz("test.dot");
 
+    // A small DAG in bulk: 3 -> 4 -> 5, 3 -> 6 -> 5, and 7 on its own
+    graph& d = gm.create();
+    var from = view({4}, 0);
+    var to = view({4}, 0);
+    var weight = view({4}, 0.0);
+    int f[] = {3, 4, 3, 6};
+    int t[] = {4, 5, 6, 5};
+    double w[] = {1.0, 5.0, 2.0, 1.0};
+    for (int i=0; i<4; i++)
+    {
+        from[i] = f[i];
+        to[i] = t[i];
+        weight[i] = w[i];
+    }
+    d.addEdges(from, to, weight);
+    d.addVertex();
+    for (int frozen=0; frozen<2; frozen++)
+    {
+        std::cout << (frozen ? "Frozen:" : "Bulk:") << std::endl;
+        std::cout << "Size: " << d.vertices() << " " << d.edges() << std::endl;
+        std::cout << "BFS: " << d.bfs(3) << std::endl;
+        std::cout << "DFS: " << d.dfs(3) << std::endl;
+        std::cout << "Distance: " << d.distance(3) << std::endl;
+        std::cout << "Path: " << d.shortestPath(3, 5) << std::endl;
+        std::cout << "Weak: " << d.components() << std::endl;
+        std::cout << "Strong: " << d.components(true) << std::endl;
+        std::cout << "Topological: " << d.topologicalSort() << std::endl;
+        std::cout << "Ancestors: " << d.ancestors(5) << std::endl;
+        std::cout << "Descendants: " << d.descendants(4) << std::endl;
+        d.freeze();
+    }
+    // Vertices of other types are cast
+    graph& e = gm.create();
+    e.addEdges(var{0.0f, 1.0f}, var{'\1', '\2'});
+    std::cout << "Cast: " << e.vertices() << " " << e.edges() << std::endl;
+
+    try
+    {
+        g.topologicalSort();
+    }
+    catch (lube::error&)
+    {
+        std::cout << "Caught cycle" << std::endl;
+    }
+
     return 0;
 }
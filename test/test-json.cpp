@@ -53,4 +53,15 @@ int main(int argc, char** argv)
     o5["second"] = o3;
     write("test5.json", o5);
     var i5 = read("test5.json");
+
+    // Objects of the same form share their keys if interned
+    var o6;
+    o6[0] = o3;
+    o6[1] = o3.copy();
+    write("test6.json", o6);
+    ifstream is("test6.json", ifstream::in);
+    var i6;
+    is >> lube::internkeys >> i6;
+    cout << "Shared keys: " << (i6[0].key(0).heap() == i6[1].key(0).heap())
+         << " " << (lube::intern("one").heap() == i6[1].key(0).heap()) << endl;
 }
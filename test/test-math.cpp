@@ -1,5 +1,6 @@
 #include "lube/lube.h"
 #include "lube/dft.h"
+#include "lube/resample.h"
 
 using namespace std;
 
@@ -157,6 +158,19 @@ int main(int argc, char** argv)
     var im = lube::iamax(fd);
     cout << "IAMax: " << im << endl;
 
+    // Resampling 3:2; the stream emits its samples later, waiting for the
+    // filter length of input, but the result is the same
+    lube::Resample rs(3, 2);
+    cout << "Resampled: " << rs(td) << endl;
+    var ts = lube::view({60});
+    for (int i=0; i<60; i++)
+        ts(i) = sinf(0.3f * i);
+    cout << "Whole: " << rs(ts) << endl;
+    lube::ResampleStream rss(3, 2);
+    cout << "Stream: " << rss(ts.view({30}, 0)) << endl;
+    cout << "Stream: " << rss(ts.view({30}, 30)) << endl;
+    cout << "Flush: " << rss.flush() << endl;
+
     // Functor view broadcast
     Unary u;
     cout << u(r6) << endl;
@@ -7,10 +7,15 @@
  *   Phil Garner, December 2014
  */
 
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
 #include "lube/lube.h"
 #include "lube/path.h"
 
 using namespace lube;
+namespace fs = std::filesystem;
 
 int main()
 {
@@ -25,6 +30,33 @@ int main()
     var rdir = p.rdir();
     std::cout << rdir << std::endl;
 
+    std::cout << "Find:" << std::endl;
+    var attr;
+    attr["glob"] = "Find*";
+    attr["ext"] = "cmake";
+    attr["threads"] = 3;
+    var find = p.find(attr, true);
+    std::cout << find << std::endl;
+
+    // A file added behind the directory's back, by putting its mtime back,
+    // is only missed if the listing comes from the index
+    std::cout << "Indexed:" << std::endl;
+    fs::create_directories("test-path.d");
+    std::ofstream("test-path.d/a.txt");
+    fs::file_time_type old =
+        fs::last_write_time("test-path.d") - std::chrono::hours(1);
+    fs::last_write_time("test-path.d", old);
+    var index;
+    index["index"] = "test-path.idx";
+    path& q = m.create("test-path.d");
+    std::cout << q.find(index) << std::endl;
+    std::ofstream("test-path.d/b.txt");
+    fs::last_write_time("test-path.d", old);
+    std::cout << "Cached: " << q.find(index) << std::endl;
+    std::cout << "Uncached: " << q.find(nil) << std::endl;
+    fs::remove("test-path.idx");
+    fs::remove_all("test-path.d");
+
     std::cout << "Tree:" << std::endl;
     var tree = p.tree();
     std::cout << tree << std::endl;
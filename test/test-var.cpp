@@ -1,5 +1,10 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <map>
+#include <numeric>
 
 #include "lube/lube.h"
 
@@ -45,6 +50,92 @@ int main(int argc, char** argv)
     else
         cout << "There's no -f" << endl;
 
+    // Searching arrays
+    var found = {3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5};
+    cout << "Index of 5: " << found.index(5) << " of 7: " << found.index(7)
+         << " of 5.0: " << found.index(5.0) << endl;
+    cout << "Indices of 5: " << found.indices(5)
+         << " count: " << found.count(5) << endl;
+    cout << "Contains 9: " << found.contains(9) << endl;
+    cout << "Is in: " << found.isin(var{1, 5, 7}) << endl;
+    var words = {"a", "b", "c", "b"};
+    cout << "Is in: " << words.isin(var{"b", "c", "d"})
+         << " count: " << words.count("b") << endl;
+    var lf = libube::range(0.0, 300.0);
+    lf[200] = -1.0;
+    lf[250] = -1.0;
+    var li = libube::view({300}, 0);
+    for (int& i : li.span<int>())
+        i = 0;
+    li[260] = 5;
+    cout << "Long index: " << lf.index(-1.0) << " " << lf.index(299.0)
+         << " count: " << lf.count(-1.0) << " " << li.count(0)
+         << " index: " << li.index(5) << endl;
+
+    // Hashing
+    var hv = {1, 2};
+    var hi = libube::view({2}, 0);
+    hi[0] = 1;
+    hi[1] = 2;
+    cout << "Hashes equal: " << (hv.hash() == hi.hash())
+         << " " << (var(0.0).hash() == var(-0.0).hash())
+         << " " << (var("ab").hash() == var("ba").hash()) << endl;
+    varset distinct(var{"x", "y", "x", "z", "y"});
+    cout << "Distinct: " << distinct.keys()
+         << " has y: " << distinct.contains("y") << endl;
+    varmap tally;
+    for (int i=0; i<found.size(); i++)
+        tally[found[i]] = tally[found[i]] ? tally[found[i]] + 1 : var(1);
+    tally.erase(9);
+    cout << "Tally: " << tally.keys() << " " << tally.values() << endl;
+
+    // Three way comparison
+    cout << "Compare: " << var("abc").compare("abd")
+         << " " << var{1, 2}.compare(var{1, 2})
+         << " " << var{1, 2, 0}.compare(var{1, 2})
+         << " " << var{3, 1}.compare(var{1, 2})
+         << " " << var(2).compare(2.0) << endl;
+
+    // Spans
+    var sf = libube::view({4}, 0.0f);
+    float fsum = 0.0f;
+    for (float& f : sf.span<float>())
+        f = 1.5f;
+    for (float f : sf.span<float>())
+        fsum += f;
+    cout << "Span sum: " << fsum << " size: " << sf.span<float>().size() << endl;
+    var im;
+    im["b"] = 2;
+    im["a"] = 1;
+    for (libube::pair& p : im.items())
+        cout << "Item: " << p.key << " " << p.val << endl;
+    try
+    {
+        sf.span<int>();
+    }
+    catch (std::exception& e)
+    {
+        cout << "Caught wrong span type" << endl;
+    }
+
+    // Iterators
+    var si = {3, 1, 2};
+    for (var e : si)
+        e += 10;
+    cout << "Iterated: " << si << endl;
+    var iv = libube::view({5}, 0);
+    std::iota(iv.span<int>().begin(), iv.span<int>().end(), 0);
+    std::reverse(iv.span<int>().begin(), iv.span<int>().end());
+    cout << "Reversed: " << iv << endl;
+    cout << "Found: " << std::find(iv.begin(), iv.end(), 3).index()
+         << " Counted: " << std::count_if(
+             iv.begin(), iv.end(), [](var e) { return e > 1; }
+         ) << " Sum: " << std::accumulate(im.begin(), im.end(), var(0))
+         << " Same: " << (si.begin() == iv.begin()) << endl;
+    for (auto& [k, v] : im.items())
+        v = k;
+    cout << "Items: " << im << endl;
+
     // Basic numerical tests
     var s, w, x, y, z, dummy;
     cout << (s ? "true" : "false") << endl;
@@ -129,12 +220,61 @@ int main(int argc, char** argv)
     var as = arg.shift();
     cout << "arg is: " << arg << " shifted: " << as << endl;
 
+    // Splicing of arrays
+    var sa = {0, 1, 2, 3, 4, 5};
+    sa.insert(var{7, 8}, 2);
+    cout << "Inserted: " << sa << endl;
+    cout << "Spliced: " << sa.splice(1, 3, var{9}) << " leaving: " << sa << endl;
+    cout << "Removed: " << sa.remove(2, 2) << " leaving: " << sa << endl;
+    cout << "Sliced: " << sa.slice(1, 3) << endl;
+    var sv = {"a", "b", "c"};
+    sv.splice(1, 1, var{"d", "e"});
+    cout << "Spliced: " << sv << endl;
+    var self = "abcdefgh";
+    self.append(self);
+    sa.insert(sa, 1);
+    cout << "Self appended: " << self << " inserted: " << sa << endl;
+
+    // Queues at either end
+    var q = {1, 2, 3};
+    for (int i=0; i<100; i++)
+    {
+        q.push(i+4);
+        q.shift();
+    }
+    q.unshift(0);
+    q.unshift(-1);
+    cout << "Queue: " << q << " shifted: " << q.shift() << endl;
+    var qs = "queue";
+    qs.shift();
+    qs.unshift('Q');
+    cout << "Queue: " << qs << endl;
+
     // Join the command line args
     cout << "Joining: " << arg << endl;
     cout << "Joined: " << arg.join("-") << endl;
+    var nums = {1.5, 2.0, -3.25};
+    cout << "Joined: " << nums.join(", ") << endl;
+    strbuilder sb;
+    sb.reserve(32);
+    sb << "n=" << 42 << ' ' << 0.1 << ' ' << var("x") << ' ' << var{1, 2};
+    sb << ' ' << std::strlen("abc") << ' ' << 7u << ' ' << -8LL << ' ' << 9ULL;
+    cout << "Built: " << var(sb) << " size: " << sb.size() << endl;
 
     // Sort the command line args
     cout << arg.sort() << endl;
+    cout << arg.argsort() << endl;
+    var isrt = {3, 1, 2, 1};
+    cout << "Sorted: " << isrt.sort() << " by: " << isrt.argsort() << endl;
+    var recs;
+    recs[0]["name"] = "b";
+    recs[0]["age"] = 30;
+    recs[1]["name"] = "a";
+    recs[1]["age"] = 40;
+    recs[2]["name"] = "c";
+    recs[2]["age"] = 30;
+    cout << "By age: " << recs.sort("age") << endl;
+    cout << "By name: " << recs.argsort("name") << endl;
 
     // Check that we can act as a std::map key (just needs operator<)
     map<var, int> map;
@@ -227,6 +367,19 @@ int main(int argc, char** argv)
     var t4({2,2}, 'd');
     cout << "View ctor: " << t4 << endl;
 
+    // Memory mapped file; writing to the map must not change the file
+    ofstream bin("test-var.bin", ofstream::binary);
+    bin.write((const char*)ts.ptr<float>(), 16*sizeof(float));
+    bin.close();
+    var mf = lube::mapfile("test-var.bin", 0.0f, 4*sizeof(float), 8);
+    cout << "Mapped: " << mf << endl;
+    cout << "Mapped view: " << mf.view({2, 4}) << endl;
+    mf[0] = 99.0f;
+    mf.push(16.0f);
+    cout << "Modified: " << mf << endl;
+    cout << "Remapped: " << lube::mapfile("test-var.bin", 0.0f, 0, 4) << endl;
+    std::remove("test-var.bin");
+
     // Init by overloading operator,()
     var comma;
     comma = 1.2, 2.0, 4, 5;